@@ -0,0 +1,113 @@
+#include <errno.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "bake.hpp"
+#include "loader.hpp"
+//离线烘焙，不需要SDL
+//用法：sdpf_bake <点云文件> <输出目录> [选项]
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "usage: %s <points> <output dir> [options]\n"
+            "  -w <width>        map width (default: from the points)\n"
+            "  -h <height>       map height (default: from the points)\n"
+            "  -m <minPathWith>  minimum path width (default: 8)\n"
+            "  -j <threads>      openmp threads (default: all)\n"
+            "  --eikonal         build the road-approach flow field with fast marching\n"
+            "  --thinning        build the skeleton by thinning instead of ridge detection\n"
+            "  --compress        save the compact encoding\n"
+            "  --report <file>   write the stage report as JSON (default: <output dir>/bake.json)\n",
+            name);
+}
+
+int main(int argc, char** argv) {
+    using namespace sdpf;
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string pointsPath = argv[1];
+    std::string outPath = argv[2];
+    std::string reportPath = outPath + "/bake.json";
+    int width = 0;
+    int height = 0;
+    int threads = 0;
+    bake::options opt;
+    for (int i = 3; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-w") == 0 && hasValue) {
+            width = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-h") == 0 && hasValue) {
+            height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && hasValue) {
+            opt.minPathWith = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0 && hasValue) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--eikonal") == 0) {
+            opt.eikonal = true;
+        } else if (strcmp(argv[i], "--thinning") == 0) {
+            opt.thinning = true;
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            opt.compress = true;
+        } else if (strcmp(argv[i], "--report") == 0 && hasValue) {
+            reportPath = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (threads > 0) {
+        omp_set_num_threads(threads);
+    }
+
+    std::vector<vec2> points;
+    loader::loadPoints(points, pointsPath);
+    if (points.empty()) {
+        fprintf(stderr, "no points in %s\n", pointsPath.c_str());
+        return 1;
+    }
+    //未指定宽高时取点云的范围
+    if (width <= 0 || height <= 0) {
+        double maxX = 0, maxY = 0;
+        for (auto& it : points) {
+            maxX = std::max(maxX, it.x);
+            maxY = std::max(maxY, it.y);
+        }
+        if (width <= 0) {
+            width = (int)ceil(maxX) + 1;
+        }
+        if (height <= 0) {
+            height = (int)ceil(maxY) + 1;
+        }
+    }
+
+    KDTree tree(points);
+    navmesh::navmesh mesh(width, height);
+    auto rep = bake::run(mesh, tree, opt);
+
+    if (mkdir(outPath.c_str(), 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "cannot create %s: %s\n", outPath.c_str(), strerror(errno));
+        return 1;
+    }
+    loader::save(mesh, outPath);
+
+    auto json = rep.toJSON();
+    auto fp = fopen(reportPath.c_str(), "w");
+    if (fp) {
+        fprintf(fp, "%s\n", json.c_str());
+        fclose(fp);
+    } else {
+        fprintf(stderr, "cannot write %s\n", reportPath.c_str());
+    }
+    for (auto& s : rep.stages) {
+        fprintf(stderr, "%-18s %9.3fs %3d threads %8lld KB\n",
+                s.name.c_str(), s.seconds, s.threads, (long long)s.peakMemoryKB);
+    }
+    fprintf(stderr, "%dx%d nodes=%zu ways=%zu total %.3fs\n",
+            width, height, mesh.nodes.size(), mesh.ways.size(), rep.seconds);
+    return 0;
+}
@@ -0,0 +1,81 @@
+//KDTree的radius和knearest与暴力搜索对比
+//点和查询都在整数格上，半径取整数，距离恰好等于半径的情况很多
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "KDTree.hpp"
+
+using namespace sdpf;
+
+int main() {
+    std::mt19937 rng(3);
+    std::vector<vec2> points;
+    for (int i = 0; i < 2000; ++i) {
+        points.push_back(vec2(rng() % 64, rng() % 64));
+    }
+    KDTree tree(points);
+    //插入和删除一些点，让查询经过多个块和墓碑
+    std::vector<bool> alive(points.size(), true);
+    for (int i = 0; i < 300; ++i) {
+        vec2 p(rng() % 64, rng() % 64);
+        if (tree.insert(p) == points.size()) {
+            points.push_back(p);
+            alive.push_back(true);
+        }
+    }
+    for (int i = 0; i < 300; ++i) {
+        size_t index = rng() % points.size();
+        if (alive[index] && tree.remove(index)) {
+            alive[index] = false;
+        }
+    }
+
+    int errors = 0;
+    auto dist2 = [](const vec2& a, const vec2& b) {
+        return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y);
+    };
+    for (int q = 0; q < 2000; ++q) {
+        vec2 pt(rng() % 64, rng() % 64);
+        double rad = rng() % 7;
+        std::vector<size_t> expect, got;
+        for (size_t i = 0; i < points.size(); ++i) {
+            if (alive[i] && dist2(points[i], pt) <= rad * rad) {
+                expect.push_back(i);
+            }
+        }
+        tree.radius(pt, rad, [&](const KDPoint& p) {
+            got.push_back(p.index);
+        });
+        std::sort(got.begin(), got.end());
+        if (got != expect) {
+            printf("radius (%g,%g) r=%g: %zu points, expected %zu\n", pt.x, pt.y, rad, got.size(), expect.size());
+            ++errors;
+        }
+
+        //距离相同的点可以任选，只比较距离
+        size_t k = 1 + rng() % 8;
+        std::vector<double> all;
+        for (size_t i = 0; i < points.size(); ++i) {
+            if (alive[i]) {
+                all.push_back(dist2(points[i], pt));
+            }
+        }
+        std::sort(all.begin(), all.end());
+        all.resize(std::min(k, all.size()));
+        std::vector<KDPoint> result(k);
+        std::vector<double> result_dist2(k);
+        size_t n = tree.knearest(pt, k, result.data(), result_dist2.data());
+        result_dist2.resize(n);
+        bool ok = result_dist2 == all;
+        for (size_t i = 0; ok && i < n; ++i) {
+            ok = alive[result[i].index] && dist2(points[result[i].index], pt) == result_dist2[i];
+        }
+        if (!ok) {
+            printf("knearest (%g,%g) k=%zu mismatch\n", pt.x, pt.y, k);
+            ++errors;
+        }
+    }
+    printf("errors=%d\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+//按id索引的A*（astar_node::search）与暴力Dijkstra对比，再在烘焙的网格上与流场寻路对比
+#include <stdio.h>
+#include <random>
+#include "bake.hpp"
+#include "pathfinding.hpp"
+
+using namespace sdpf;
+
+//随机图：边长不小于两端的直线距离，启发函数可采纳
+static int randomGraphs() {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> stretch(1., 1.5);
+    astar_node::graph atx;  //所有查询复用同一个搜索状态
+    int errors = 0;
+    for (int round = 0; round < 50; ++round) {
+        const int n = 2 + rng() % 60;
+        //下标0、1为临时起点、终点（id为-1、-2），其余为id 1..n
+        std::vector<navmesh::node> nodes(n + 2);
+        for (int i = 0; i < n + 2; ++i) {
+            nodes[i].id = i < 2 ? -1 - i : i - 1;
+            nodes[i].position = ivec2(rng() % 100, rng() % 100);
+        }
+        std::vector<std::vector<std::pair<int, double>>> edges(n + 2);
+        auto connect = [&](int a, int b) {
+            double len = nodes[a].position.length(nodes[b].position) * stretch(rng);
+            edges[a].emplace_back(b, len);
+            edges[b].emplace_back(a, len);
+        };
+        const int m = rng() % (n * 3);
+        for (int k = 0; k < m; ++k) {
+            connect(2 + rng() % n, 2 + rng() % n);  //可能有重边和自环
+        }
+        connect(0, 2 + rng() % n);
+        connect(1, 2 + rng() % n);
+        auto neighbors = [&](navmesh::node* p, auto emit) {
+            for (auto& e : edges[p - nodes.data()]) {
+                emit(&nodes[e.first], e.second);
+            }
+        };
+        for (int q = 0; q < 20; ++q) {
+            int a = q == 0 ? 0 : rng() % (n + 2);
+            int b = q == 0 ? 1 : rng() % (n + 2);
+            //暴力Dijkstra
+            std::vector<double> dist(n + 2, INFINITY);
+            std::vector<uint8_t> done(n + 2, 0);
+            dist[a] = 0;
+            while (true) {
+                int u = -1;
+                for (int i = 0; i < n + 2; ++i) {
+                    if (!done[i] && dist[i] < INFINITY && (u < 0 || dist[i] < dist[u])) {
+                        u = i;
+                    }
+                }
+                if (u < 0) {
+                    break;
+                }
+                done[u] = 1;
+                for (auto& e : edges[u]) {
+                    dist[e.first] = std::min(dist[e.first], dist[u] + e.second);
+                }
+            }
+            bool found = astar_node::search(atx, &nodes[a], &nodes[b], neighbors);
+            if (found != (dist[b] < INFINITY)) {
+                printf("graph %d: %d->%d found=%d expect %d\n", round, a, b, found, dist[b] < INFINITY);
+                ++errors;
+                continue;
+            }
+            if (!found) {
+                continue;
+            }
+            //回溯的路线必须首尾正确、每段都是存在的边，长度等于最短路
+            std::vector<navmesh::node*> road;
+            astar_node::buildRoad(atx, [&](navmesh::node* p) {
+                road.push_back(p);
+            });
+            double len = 0;
+            bool valid = road.front() == &nodes[b] && road.back() == &nodes[a];
+            for (size_t i = 1; valid && i < road.size(); ++i) {
+                double best = INFINITY;
+                for (auto& e : edges[road[i] - nodes.data()]) {
+                    if (&nodes[e.first] == road[i - 1]) {
+                        best = std::min(best, e.second);
+                    }
+                }
+                valid = best < INFINITY;
+                len += best;
+            }
+            if (!valid || fabs(len - dist[b]) > 1e-9 * (1 + dist[b])) {
+                printf("graph %d: %d->%d length %.6f expect %.6f valid=%d\n", round, a, b, len, dist[b], valid);
+                ++errors;
+            }
+        }
+    }
+    return errors;
+}
+
+static double pathLength(const std::vector<ivec2>& path) {
+    double len = 0;
+    for (size_t i = 1; i < path.size(); ++i) {
+        len += path[i].length(path[i - 1]);
+    }
+    return len;
+}
+
+//烘焙的网格：A*与流场的可达性相同，首尾相同，A*的路线不比流场的长（流场按广搜的顺序松弛，不一定最短）
+//不限制路宽，与流场相同
+static int bakedMesh() {
+    const int width = 256;
+    std::mt19937 rng(3);
+    std::vector<vec2> points;
+    for (int b = 0; b < width / 6; ++b) {
+        int x0 = rng() % width;
+        int y0 = rng() % width;
+        int bw = 2 + rng() % (width / 10);
+        int bh = 2 + rng() % (width / 10);
+        for (int i = 0; i <= bw; ++i) {
+            for (int j = 0; j <= bh; ++j) {
+                points.push_back(vec2(x0 + i, y0 + j));
+            }
+        }
+    }
+    KDTree tree(points);
+    navmesh::navmesh mesh(width, width);
+    bake::run(mesh, tree);
+
+    astar_node::graph atx;
+    int errors = 0, compared = 0;
+    for (int q = 0; q < 500; ++q) {
+        vec2 a(rng() % width, rng() % width);
+        vec2 b(rng() % width, rng() % width);
+        std::vector<ivec2> flow, search;
+        pathfinding::buildNodePath(mesh, a, b, flow, -1, 0);
+        pathfinding::buildNodePath(mesh, a, b, search, -1, 0, &atx);
+        if (flow.empty() != search.empty()) {
+            printf("(%g,%g)->(%g,%g): flow %zu points, A* %zu points\n", a.x, a.y, b.x, b.y, flow.size(), search.size());
+            ++errors;
+            continue;
+        }
+        if (flow.empty()) {
+            continue;
+        }
+        ++compared;
+        if (search.front() != flow.front() || search.back() != flow.back()) {
+            printf("(%g,%g)->(%g,%g): endpoints differ\n", a.x, a.y, b.x, b.y);
+            ++errors;
+        }
+        double lf = pathLength(flow);
+        double ls = pathLength(search);
+        if (ls > lf + 1e-6) {
+            printf("(%g,%g)->(%g,%g): A* %.2f longer than flow %.2f\n", a.x, a.y, b.x, b.y, ls, lf);
+            ++errors;
+        }
+    }
+    printf("mesh: compared=%d\n", compared);
+    return errors;
+}
+
+int main() {
+    int errors = randomGraphs() + bakedMesh();
+    printf("errors=%d\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,269 @@
+//局部重新烘焙与整张图重新烘焙对比
+//在若干矩形里增删障碍物，每次用rebake::update更新，再与编辑后的地图完整烘焙的结果比较
+//用法：sdpf_check_rebake [eikonal(0/1)] [随机种子]
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <random>
+#include <set>
+#include "bake.hpp"
+#include "rebake.hpp"
+
+using namespace sdpf;
+
+typedef std::pair<int, int> cell;
+static cell toCell(const ivec2& p) {
+    return cell(p.x, p.y);
+}
+
+//两端节点位置相同的路线视为同一条
+static std::map<std::pair<cell, cell>, navmesh::way*> wayMap(navmesh::navmesh& mesh) {
+    std::map<std::pair<cell, cell>, navmesh::way*> res;
+    for (auto& it : mesh.ways) {
+        auto a = toCell(it.second->p1->position);
+        auto b = toCell(it.second->p2->position);
+        res[std::make_pair(std::min(a, b), std::max(a, b))] = it.second.get();
+    }
+    return res;
+}
+
+//沿流场最多走steps步，返回是否走到路上
+static bool reachRoad(navmesh::navmesh& mesh, int x, int y, int steps) {
+    ivec2 c(x, y);
+    for (int i = 0; i < steps; ++i) {
+        auto& nav = mesh.pathNavMap.at(c.x, c.y);
+        if (nav.cost == 0) {
+            return true;
+        }
+        if (nav.target.x < 0) {
+            return false;
+        }
+        c = nav.target;
+    }
+    return false;
+}
+
+//最近点有多个时，局部更新与完整烘焙可能选了不同的点，这些格子附近的山脊、节点和路线允许不同
+const int tieRange = 4;
+
+//costNear内的格子cost与完整烘焙接近；外面的格子沿流场走不经过重算范围时保持原样，
+//只要求不比完整烘焙的结果小（仍是一条走到路上的路线）
+//广搜烘焙的cost依赖全图的访问顺序，局部用Dijkstra重算，不比较cost
+static int compare(navmesh::navmesh& mesh, navmesh::navmesh& full, bool costs, double minPathWith, const rebake::rect& costNear, const char* tag) {
+    const int w = mesh.width;
+    const int h = mesh.height;
+    int errors = 0;
+    auto fail = [&](const char* what, int x, int y) {
+        if (errors < 8) {
+            printf("%s: %s at (%d,%d)\n", tag, what, x, y);
+        }
+        ++errors;
+    };
+    std::vector<ivec2> tiePoints;
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            if (!(mesh.vsdfMap.at(x, y).pos == full.vsdfMap.at(x, y).pos)) {
+                tiePoints.push_back(ivec2(x, y));
+            }
+        }
+    }
+    auto nearTie = [&](const ivec2& p, int range) {
+        for (auto& t : tiePoints) {
+            if (abs(t.x - p.x) <= range && abs(t.y - p.y) <= range) {
+                return true;
+            }
+        }
+        return false;
+    };
+    //p所在的节点块（任意一边）挨着最近点不同的格子时，节点块可能因多出的短山脊而合并或分开
+    auto nearTieBlock = [&](const ivec2& p) {
+        bool res = false;
+        for (auto* m : {&mesh, &full}) {
+            int32_t id = m->idMap.at(p.x, p.y);
+            if (id > 0) {
+                rebake::floodId(*m, p, id, [&](const ivec2& q) {
+                    res = res || nearTie(q, tieRange);
+                });
+            }
+        }
+        return res;
+    };
+    //sdf必须完全相同
+    int ties = 0;
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            if (mesh.sdfMap.at(x, y) != full.sdfMap.at(x, y)) {
+                fail("sdf differs", x, y);
+            }
+            auto ridge = [](int32_t id) {
+                return id == -2 || id > 0;
+            };
+            if (ridge(mesh.idMap.at(x, y)) != ridge(full.idMap.at(x, y))) {
+                if (nearTie(ivec2(x, y), 1)) {
+                    ++ties;
+                } else {
+                    fail("ridge differs", x, y);
+                }
+            }
+        }
+    }
+    //节点位置相同，id连续
+    std::set<cell> nodes, fullNodes;
+    for (size_t i = 0; i < mesh.nodes.size(); ++i) {
+        auto& n = mesh.nodes[i];
+        if (!n || n->id != (int32_t)i + 1 || mesh.idMap.at(n->position.x, n->position.y) != n->id) {
+            fail("bad node id", i, 0);
+            continue;
+        }
+        nodes.insert(toCell(n->position));
+    }
+    for (auto& n : full.nodes) {
+        fullNodes.insert(toCell(n->position));
+    }
+    for (auto& n : nodes) {
+        if (!fullNodes.count(n) && !nearTieBlock(ivec2(n.first, n.second))) {
+            fail("extra node", n.first, n.second);
+        }
+    }
+    for (auto& n : fullNodes) {
+        if (!nodes.count(n) && !nearTieBlock(ivec2(n.first, n.second))) {
+            fail("node missing", n.first, n.second);
+        }
+    }
+    //连接相同的节点，长度相近（路线可以走等价的另一条像素路径）
+    auto ways = wayMap(mesh);
+    auto fullWays = wayMap(full);
+    auto matchWays = [&](std::map<std::pair<cell, cell>, navmesh::way*>& from,
+                         std::map<std::pair<cell, cell>, navmesh::way*>& to,
+                         const char* what) {
+        for (auto& it : from) {
+            auto& a = it.first.first;
+            auto& b = it.first.second;
+            auto found = to.find(it.first);
+            if (found == to.end()) {
+                if (!nearTieBlock(ivec2(a.first, a.second)) && !nearTieBlock(ivec2(b.first, b.second))) {
+                    fail(what, a.first, a.second);
+                }
+                continue;
+            }
+            if (fabs(found->second->length - it.second->length) > 0.05 * it.second->length + 2) {
+                fail("way length differs", a.first, a.second);
+            }
+        }
+    };
+    matchWays(fullWays, ways, "way missing");
+    matchWays(ways, fullWays, "extra way");
+    for (auto& it : mesh.ways) {
+        auto& key = it.first;
+        auto& way = *it.second;
+        if (key.first != way.p1->id || key.second != way.p2->id || key.first >= key.second) {
+            fail("bad way key", key.first, key.second);
+        }
+        for (auto& p : way.maxPath) {
+            int32_t id = mesh.idMap.at(p.x, p.y);
+            if (id != -2 && id != key.first && id != key.second) {
+                fail("way leaves the ridge", p.x, p.y);
+            }
+        }
+    }
+    //流场：可达性相同，每个格子都能走到路上；只比较路宽足够的格子的cost
+    //（障碍物里的cost很大，局部求解以范围外原来的cost为边界，允许2%的相对误差）
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            double a = mesh.pathNavMap.at(x, y).cost;
+            double b = full.pathNavMap.at(x, y).cost;
+            if ((a < 0) != (b < 0)) {
+                fail("reachability differs", x, y);
+                continue;
+            }
+            if (a < 0) {
+                continue;
+            }
+            if (!reachRoad(mesh, x, y, w * h)) {
+                fail("flow does not reach a road", x, y);
+            }
+            if (!costs || mesh.sdfMap.at(x, y) <= minPathWith) {
+                continue;
+            }
+            double tolerance = 5 + 0.02 * b;
+            if (a < b - tolerance || (a > b + tolerance && costNear.contains(x, y))) {
+                fail("flow cost differs", x, y);
+            }
+        }
+    }
+    printf("%s: ridge ties=%d errors=%d\n", tag, ties, errors);
+    return errors;
+}
+
+int main(int argc, char** argv) {
+    const int width = 256;
+    bake::options opt;
+    opt.eikonal = argc > 1 ? atoi(argv[1]) : 1;
+
+    //空心矩形房间
+    std::mt19937 rng(argc > 2 ? atoi(argv[2]) : 7);
+    std::vector<vec2> points;
+    auto box = [&](std::vector<vec2>& out, int x0, int y0, int w, int h) {
+        for (int i = 0; i <= w; ++i) {
+            out.push_back(vec2(x0 + i, y0));
+            out.push_back(vec2(x0 + i, y0 + h));
+        }
+        for (int j = 1; j < h; ++j) {
+            out.push_back(vec2(x0, y0 + j));
+            out.push_back(vec2(x0 + w, y0 + j));
+        }
+    };
+    for (int b = 0; b < width / 8; ++b) {
+        int x0 = rng() % width;
+        int y0 = rng() % width;
+        int bw = 4 + rng() % (width / 6);
+        int bh = 4 + rng() % (width / 6);
+        box(points, x0, y0, bw, bh);
+    }
+    KDTree tree(points);
+    navmesh::navmesh mesh(width, width);
+    bake::run(mesh, tree, opt);
+
+    int errors = 0;
+    for (int it = 0; it < 8; ++it) {
+        std::vector<vec2> added, removed;
+        int x0 = rng() % (width - 20);
+        int y0 = rng() % (width - 20);
+        int bw = 3 + rng() % 12;
+        int bh = 3 + rng() % 12;
+        box(added, x0, y0, bw, bh);
+        for (auto& p : added) {
+            tree.insert(p);
+        }
+        if (it % 3 == 2) {  //删掉之前的一些点
+            for (int k = 0; k < 20 && !points.empty(); ++k) {
+                auto p = points.back();
+                points.pop_back();
+                if (tree.remove(p)) {
+                    removed.push_back(p);
+                }
+            }
+        }
+        points.insert(points.end(), added.begin(), added.end());
+        if (!rebake::update(mesh, tree, added, removed, opt.minPathWith)) {
+            printf("edit %d: update failed\n", it);
+            ++errors;
+            continue;
+        }
+        navmesh::navmesh full(width, width);
+        bake::run(full, tree, opt);
+        char tag[32];
+        snprintf(tag, sizeof(tag), "edit %d", it);
+        //cost只在编辑过的格子附近要求与完整烘焙接近
+        rebake::rect near;
+        for (auto& p : added) {
+            near.add(ivec2(p.x, p.y));
+        }
+        for (auto& p : removed) {
+            near.add(ivec2(p.x, p.y));
+        }
+        errors += compare(mesh, full, opt.eikonal, opt.minPathWith, near.expand(8, width, width), tag);
+    }
+    printf("eikonal=%d errors=%d\n", (int)opt.eikonal, errors);
+    return errors ? 1 : 0;
+}
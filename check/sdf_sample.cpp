@@ -0,0 +1,89 @@
+//sdf::sample批量查找与逐个operator[]的双线性插值对比
+//点包括内部、正好在边和角上、离边不到epsilon以及地图外的，两种缩放；x86上分别检查AVX2和SSE2内核
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "sdf.hpp"
+
+using namespace sdpf;
+
+int main() {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> value(-4., 40.);
+    const int w = 37;
+    const int h = 29;
+    sdf::sdf map(w, h);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            map.at(x, y) = value(rng);
+        }
+    }
+
+    int errors = 0;
+    for (double scale : {1.0, 0.5}) {
+        map.scale = scale;
+        //世界坐标，乘以scale后为像素坐标
+        std::vector<vec2> pos;
+        std::uniform_real_distribution<double> inner(0., 1.);
+        for (int i = 0; i < 4000; ++i) {
+            pos.push_back(vec2(inner(rng) * (w - 1), inner(rng) * (h - 1)) / scale);
+        }
+        //边和角：正好在边上、离边不到epsilon、刚超出
+        const double edgeX[] = {0., 1e-9, w - 1 - 1e-3, w - 1 - 1e-5, w - 1., w - 1 + 1e-5, -1e-5, w + 3., -2.};
+        const double edgeY[] = {0., 1e-9, h - 1 - 1e-3, h - 1 - 1e-5, h - 1., h - 1 + 1e-5, -1e-5, h + 3., -2.};
+        for (double ex : edgeX) {
+            for (int k = 0; k < 5; ++k) {
+                pos.push_back(vec2(ex, inner(rng) * (h - 1)) / scale);
+            }
+            for (double ey : edgeY) {
+                pos.push_back(vec2(ex, ey) / scale);
+            }
+        }
+        for (double ey : edgeY) {
+            for (int k = 0; k < 5; ++k) {
+                pos.push_back(vec2(inner(rng) * (w - 1), ey) / scale);
+            }
+        }
+        std::shuffle(pos.begin(), pos.end(), rng);
+        const int count = pos.size();
+
+        std::vector<double> expect(count);
+        for (int i = 0; i < count; ++i) {
+            expect[i] = map[pos[i]];
+        }
+        auto check = [&](const char* name, const std::vector<double>& out, int n) {
+            for (int i = 0; i < n; ++i) {
+                if (out[i] != expect[i]) {
+                    if (errors < 10) {
+                        printf("%s scale=%g: (%g,%g) got %.17g expect %.17g\n",
+                               name, scale, pos[i].x, pos[i].y, out[i], expect[i]);
+                    }
+                    ++errors;
+                }
+            }
+        };
+        //不是整块的长度，最后几个点走标量路径
+        for (int n : {count, count - 1, count - 3}) {
+            std::vector<double> out(count, NAN);
+            map.sample(pos.data(), n, out.data());
+            check("sample", out, n);
+        }
+#if defined(SDPF_SDF_X86_SIMD)
+        {
+            std::vector<double> out(count, NAN);
+            int done = map.sampleSSE2(pos.data(), count, out.data());
+            check("sse2", out, done);
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            std::vector<double> out(count, NAN);
+            int done = map.sampleAVX2(pos.data(), count, out.data());
+            check("avx2", out, done);
+        } else {
+            printf("cpu without avx2, avx2 kernel not checked\n");
+        }
+#endif
+    }
+    printf("errors=%d\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+//分块烘焙的世界与整张图烘焙的单个导航网格对比寻路结果
+//用法：sdpf_check_world [输出目录]
+#include <stdio.h>
+#include <stdlib.h>
+#include <filesystem>
+#include <random>
+#include "pathfinding.hpp"
+#include "world.hpp"
+
+using namespace sdpf;
+
+int main(int argc, char** argv) {
+    const int width = 512, tileSize = 128, margin = 32;
+    std::string dir = argc > 1 ? argv[1] : "world_check";
+    std::filesystem::remove_all(dir);
+
+    //随机摆放的实心矩形障碍物
+    std::mt19937 rng(7);
+    std::vector<vec2> points;
+    for (int b = 0; b < width / 6; ++b) {
+        int x0 = rng() % width, y0 = rng() % width;
+        int w = 2 + rng() % (width / 12), h = 2 + rng() % (width / 12);
+        for (int i = 0; i <= w; ++i) {
+            for (int j = 0; j <= h; ++j) {
+                if (i == 0 || j == 0 || i == w || j == h) {
+                    points.push_back(vec2(x0 + i, y0 + j));
+                }
+            }
+        }
+    }
+    KDTree tree(points);
+    if (!world::bake(dir, tree, width, width, tileSize, margin, 8)) {
+        printf("bake failed\n");
+        return 1;
+    }
+    world::world wd;
+    if (!world::open(wd, dir)) {
+        printf("open failed\n");
+        return 1;
+    }
+    navmesh::navmesh mesh(width, width);
+    bake::run(mesh, tree);
+
+    int errors = 0;
+    //端口配对必须对称
+    for (int ty = 0; ty < wd.tilesY(); ++ty) {
+        for (int tx = 0; tx < wd.tilesX(); ++tx) {
+            auto t = world::get(wd, {tx, ty});
+            if (t == nullptr) {
+                continue;
+            }
+            int n = t->vertices.size();
+            for (int i = 0; i < n; ++i) {
+                world::vertexRef r{{tx, ty}, i};
+                if (world::get(wd, r.tile)->vertices[i].side == world::sideNone) {
+                    continue;
+                }
+                auto m = world::matchPortal(wd, r);
+                if (m.index >= 0 && !(world::matchPortal(wd, m) == r)) {
+                    printf("asymmetric portal (%d,%d)#%d\n", tx, ty, i);
+                    ++errors;
+                }
+            }
+        }
+    }
+
+    //单个网格能走通且路径不穿墙时，世界也必须能走通，且路径连续、端点一致
+    std::mt19937 query(5);
+    int clean = 0;
+    double maxStepMono = 0, maxStepWorld = 0;
+    for (int q = 0; q < 300; ++q) {
+        ivec2 a(query() % width, query() % width), b(query() % width, query() % width);
+        std::vector<ivec2> pm;
+        pathfinding::buildNodePath(mesh, vec2(a.x, a.y), vec2(b.x, b.y), pm);
+        if (pm.empty()) {
+            continue;
+        }
+        bool through = false;
+        for (auto& p : pm) {
+            through |= mesh.sdfMap.at(p.x, p.y) < 1;
+        }
+        for (size_t i = 1; i < pm.size(); ++i) {
+            maxStepMono = std::max(maxStepMono, pm[i].length(pm[i - 1]));
+        }
+        std::vector<ivec2> pw;
+        if (!world::findPath(wd, a, b, pw)) {
+            if (!through) {
+                printf("world failed (%d,%d)->(%d,%d)\n", a.x, a.y, b.x, b.y);
+                ++errors;
+            }
+            continue;
+        }
+        clean += !through;
+        if (pw.front() != a || pw.back() != b) {
+            printf("endpoint mismatch (%d,%d)->(%d,%d)\n", a.x, a.y, b.x, b.y);
+            ++errors;
+        }
+        for (size_t i = 1; i < pw.size(); ++i) {
+            maxStepWorld = std::max(maxStepWorld, pw[i].length(pw[i - 1]));
+        }
+    }
+    //节点内部本来就会跳过几格，只要求不比单个网格跳得更远
+    if (maxStepWorld > maxStepMono) {
+        printf("path gap %.2f > %.2f\n", maxStepWorld, maxStepMono);
+        ++errors;
+    }
+    printf("clean=%d maxStep=%.2f/%.2f errors=%d\n", clean, maxStepWorld, maxStepMono, errors);
+    std::filesystem::remove_all(dir);
+    return errors ? 1 : 0;
+}
@@ -49,6 +49,18 @@ struct context {
     int viewMode = VIEW;
     inline void addPoint(double x, double y) {
         points.push_back(std::vector<double>({x / 5., y / 5.}));
+        //点云索引保持更新，生成地图时无须重建
+        if (!tree) {
+            tree = new KDTree();
+        }
+        tree->insert(vec2(x / 5., y / 5.));
+    }
+    inline void clearPoints() {
+        points.clear();
+        if (tree) {
+            delete tree;
+            tree = nullptr;
+        }
     }
     inline void addActiveNode(double x, double y) {
         auto point_begin = ivec2(x / 5., y / 5.);
@@ -92,12 +104,7 @@ struct context {
             delete mesh;
             mesh = nullptr;
         }
-        if (tree) {
-            delete tree;
-            tree = nullptr;
-        }
-        if (!points.empty()) {
-            tree = new KDTree(points);
+        if (tree && !tree->empty()) {
             //for (auto& it : points) {
             //    printf("point:(%lf,%lf)\n", it.at(0), it.at(1));
             //}
@@ -216,7 +223,7 @@ struct context {
                 updateMesh();
             }
             if (ImGui::Button("清空点云")) {
-                points.clear();
+                clearPoints();
             }
             if (ImGui::Button("保存")) {
                 if (mesh) {
@@ -35,7 +35,7 @@ inline void drawSDF(navmesh::navmesh& map, const ImVec2& p0) {
         for (int y = 0; y < map.height; ++y) {
             int px = x * 5;
             int py = y * 5;
-            auto val = map.sdfMap.at(x, y);
+            auto val = map.getSdf(x, y);
             if (val > 256) {
                 draw_list->AddRectFilled(ImVec2(px + p0.x, py + p0.y),
                                          ImVec2(px + p0.x + 5, py + 5), col_w);
@@ -9,316 +9,441 @@
  * more queries than the original, namely finding all points at a distance
  * smaller than some given distance to a point.
  *
+ * The recursive descent of the original is replaced by an explicit stack
+ * over the implicit node arrays, visiting the nodes in the same order.
+ * Queries run over every tree of the forest in turn, sharing the best
+ * distance found so far.
+ *
  */
 
 #include <algorithm>
 #include <cmath>
-#include <functional>
 #include <iterator>
 #include <limits>
-#include <memory>
 #include <vector>
 
 #include "KDTree.hpp"
 
-KDNode::KDNode() = default;
-
-KDNode::KDNode(const point_t &pt, const size_t &idx_, const KDNodePtr &left_,
-               const KDNodePtr &right_) {
-    x = pt;
-    index = idx_;
-    left = left_;
-    right = right_;
-}
+namespace {
 
-KDNode::KDNode(const pointIndex &pi, const KDNodePtr &left_,
-               const KDNodePtr &right_) {
-    x = pi.first;
-    index = pi.second;
-    left = left_;
-    right = right_;
+inline double coord(const sdpf::vec2 &p, const size_t &level) {
+    return level == 0 ? p.x : p.y;
 }
 
-KDNode::~KDNode() = default;
-
-double KDNode::coord(const size_t &idx) { return x.at(idx); }
-KDNode::operator bool() { return (!x.empty()); }
-KDNode::operator point_t() { return x; }
-KDNode::operator size_t() { return index; }
-KDNode::operator pointIndex() { return pointIndex(x, index); }
-
-KDNodePtr NewKDNodePtr() {
-    KDNodePtr mynode = std::make_shared< KDNode >();
-    return mynode;
+inline double dist2(const sdpf::vec2 &a, const sdpf::vec2 &b) {
+    double dx = a.x - b.x;
+    double dy = a.y - b.y;
+    return dx * dx + dy * dy;
 }
 
-inline double dist2(const point_t &a, const point_t &b) {
-    double distc = 0;
-    for (size_t i = 0; i < a.size(); i++) {
-        double di = a.at(i) - b.at(i);
-        distc += di * di;
-    }
-    return distc;
+inline sdpf::vec2 to_vec2(const point_t &pt) {
+    return sdpf::vec2(pt.at(0), pt.at(1));
 }
 
-inline double dist2(const KDNodePtr &a, const KDNodePtr &b) {
-    return dist2(a->x, b->x);
+inline point_t to_point(const sdpf::vec2 &pt) {
+    return point_t({pt.x, pt.y});
 }
 
-inline double dist(const point_t &a, const point_t &b) {
-    return std::sqrt(dist2(a, b));
+// max-heap on the distances, kept in the caller's two buffers
+void heap_sift_up(KDPoint *result, double *result_dist2, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (result_dist2[parent] >= result_dist2[i]) {
+            break;
+        }
+        std::swap(result[parent], result[i]);
+        std::swap(result_dist2[parent], result_dist2[i]);
+        i = parent;
+    }
 }
 
-inline double dist(const KDNodePtr &a, const KDNodePtr &b) {
-    return std::sqrt(dist2(a, b));
+void heap_sift_down(KDPoint *result, double *result_dist2, size_t i,
+                    const size_t &count) {
+    while (true) {
+        size_t largest = i;
+        size_t l = 2 * i + 1;
+        size_t r = 2 * i + 2;
+        if (l < count && result_dist2[l] > result_dist2[largest]) {
+            largest = l;
+        }
+        if (r < count && result_dist2[r] > result_dist2[largest]) {
+            largest = r;
+        }
+        if (largest == i) {
+            break;
+        }
+        std::swap(result[largest], result[i]);
+        std::swap(result_dist2[largest], result_dist2[i]);
+        i = largest;
+    }
 }
 
-comparer::comparer(size_t idx_) : idx{idx_} {};
-
-inline bool comparer::compare_idx(const pointIndex &a,  //
-                                  const pointIndex &b   //
+void make_tree(std::vector< KDPoint > &nodes,  //
+               const size_t &begin,            //
+               const size_t &end,              //
+               const size_t &level             //
 ) {
-    return (a.first.at(idx) < b.first.at(idx));  //
-}
-
-inline void sort_on_idx(const pointIndexArr::iterator &begin,  //
-                        const pointIndexArr::iterator &end,    //
-                        size_t idx) {
-    comparer comp(idx);
-    comp.idx = idx;
+    size_t length = end - begin;
+    if (length == 0) {
+        return;  // empty tree
+    }
 
-    using std::placeholders::_1;
-    using std::placeholders::_2;
+    auto first = nodes.begin() + begin;
+    auto middle = first + length / 2;
+    if (length > 1) {
+        std::nth_element(first, middle, nodes.begin() + end,
+                         [level](const KDPoint &a, const KDPoint &b) {
+                             return coord(a.pos, level) < coord(b.pos, level);
+                         });
+    }
 
-    std::nth_element(begin, begin + std::distance(begin, end) / 2,
-                     end, std::bind(&comparer::compare_idx, comp, _1, _2));
+    size_t mid = begin + length / 2;
+    make_tree(nodes, begin, mid, (level + 1) % 2);
+    make_tree(nodes, mid + 1, end, (level + 1) % 2);
 }
 
-using pointVec = std::vector< point_t >;
-
-KDNodePtr KDTree::make_tree(const pointIndexArr::iterator &begin,  //
-                            const pointIndexArr::iterator &end,    //
-                            const size_t &length,                  //
-                            const size_t &level                    //
+void search_nearest(const std::vector< KDPoint > &nodes,  //
+                    const unsigned char *alive,           //
+                    const sdpf::vec2 &pt,                 //
+                    KDPoint &best,                        //
+                    double &best_dist2,                   //
+                    bool &found                           //
 ) {
-    if (begin == end) {
-        return NewKDNodePtr();  // empty tree
+    if (nodes.empty()) {
+        return;
     }
 
-    size_t dim = begin->first.size();
+    // a subtree is out of reach if its splitting line is beyond the best
+    // distance, ties are only visited while nothing has been found yet
+    auto out_of_reach = [&](const double &bound) {
+        return found ? bound >= best_dist2 : bound > best_dist2;
+    };
+
+    KDFrame stack[KDTree::max_depth + 1];
+    size_t top = 0;
+    stack[top++] = KDFrame{0, nodes.size(), 0, 0.};
+
+    while (top > 0) {
+        const KDFrame f = stack[--top];
+        // only check the other branch if it makes sense to do so
+        if (out_of_reach(f.bound)) {
+            continue;
+        }
 
-    if (length > 1) {
-        sort_on_idx(begin, end, level);
-    }
+        size_t mid = f.begin + (f.end - f.begin) / 2;
+        const KDPoint &branch = nodes[mid];
 
-    auto middle = begin + (length / 2);
+        // removed points still split the space but are never returned
+        if (alive[branch.index]) {
+            double d = dist2(branch.pos, pt);
+            if (d < best_dist2 || (!found && d <= best_dist2)) {
+                best_dist2 = d;
+                best = branch;
+                found = true;
+            }
+        }
 
-    auto l_begin = begin;
-    auto l_end = middle;
-    auto r_begin = middle + 1;
-    auto r_end = end;
+        double dx = coord(branch.pos, f.level) - coord(pt, f.level);
+        size_t next_lv = (f.level + 1) % 2;
+
+        // select which branch makes sense to check, the nearer one is
+        // pushed last so that it is searched first
+        KDFrame left{f.begin, mid, next_lv, 0.};
+        KDFrame right{mid + 1, f.end, next_lv, 0.};
+        KDFrame &section = dx > 0 ? left : right;
+        KDFrame &other = dx > 0 ? right : left;
+        other.bound = dx * dx;
+        if (other.begin < other.end && !out_of_reach(other.bound)) {
+            stack[top++] = other;
+        }
+        if (section.begin < section.end) {
+            stack[top++] = section;
+        }
+    }
+}
 
-    size_t l_len = length / 2;
-    size_t r_len = length - l_len - 1;
+}  // namespace
 
-    KDNodePtr left;
-    if (l_len > 0 && dim > 0) {
-        left = make_tree(l_begin, l_end, l_len, (level + 1) % dim);
-    } else {
-        left = leaf;
-    }
-    KDNodePtr right;
-    if (r_len > 0 && dim > 0) {
-        right = make_tree(r_begin, r_end, r_len, (level + 1) % dim);
-    } else {
-        right = leaf;
+void KDTree::build(block &&nodes) {
+    blocks.clear();
+    alive.assign(nodes.size(), 1);
+    alive_count = nodes.size();
+    dead_count = 0;
+    if (nodes.empty()) {
+        return;
     }
+    make_tree(nodes, 0, nodes.size(), 0);
+    blocks.push_back(std::move(nodes));
+}
 
-    // KDNode result = KDNode();
-    return std::make_shared< KDNode >(*middle, left, right);
+void KDTree::rebuild() {
+    block nodes;
+    nodes.reserve(alive_count);
+    for (auto &it : blocks) {
+        for (auto &p : it) {
+            if (alive[p.index]) {
+                nodes.push_back(p);
+            }
+        }
+    }
+    blocks.clear();
+    dead_count = 0;
+    if (!nodes.empty()) {
+        make_tree(nodes, 0, nodes.size(), 0);
+        blocks.push_back(std::move(nodes));
+    }
 }
 
-KDTree::KDTree(pointVec point_array) {
-    leaf = std::make_shared< KDNode >();
-    // iterators
-    pointIndexArr arr;
+KDTree::KDTree(const pointVec &point_array) {
+    block nodes(point_array.size());
     for (size_t i = 0; i < point_array.size(); i++) {
-        arr.push_back(pointIndex(point_array.at(i), i));
+        nodes[i].pos = to_vec2(point_array.at(i));
+        nodes[i].index = i;
     }
+    build(std::move(nodes));
+}
 
-    auto begin = arr.begin();
-    auto end = arr.end();
-
-    size_t length = arr.size();
-    size_t level = 0;  // starting
-
-    root = KDTree::make_tree(begin, end, length, level);
+KDTree::KDTree(const std::vector< sdpf::vec2 > &point_array) {
+    block nodes(point_array.size());
+    for (size_t i = 0; i < point_array.size(); i++) {
+        nodes[i].pos = point_array[i];
+        nodes[i].index = i;
+    }
+    build(std::move(nodes));
 }
 
-KDNodePtr KDTree::nearest_(   //
-    const KDNodePtr &branch,  //
-    const point_t &pt,        //
-    const size_t &level,      //
-    const KDNodePtr &best,    //
-    const double &best_dist   //
-) {
-    double d, dx, dx2;
+KDTree::KDTree(const double *xy, const size_t &count) {
+    block nodes(count);
+    for (size_t i = 0; i < count; i++) {
+        nodes[i].pos = sdpf::vec2(xy[2 * i], xy[2 * i + 1]);
+        nodes[i].index = i;
+    }
+    build(std::move(nodes));
+}
 
-    if (!bool(*branch)) {
-        return NewKDNodePtr();  // basically, null
+KDTree::KDTree(const float *xy, const size_t &count) {
+    block nodes(count);
+    for (size_t i = 0; i < count; i++) {
+        nodes[i].pos = sdpf::vec2(xy[2 * i], xy[2 * i + 1]);
+        nodes[i].index = i;
     }
+    build(std::move(nodes));
+}
 
-    point_t branch_pt(*branch);
-    size_t dim = branch_pt.size();
+size_t KDTree::insert(const sdpf::vec2 &pt) {
+    size_t index = alive.size();
+    alive.push_back(1);
+    ++alive_count;
+
+    // binary counter: merge the trailing trees that are not bigger than
+    // the new one, so every point is rebuilt O(log n) times in total
+    block carry(1, KDPoint{pt, index});
+    while (!blocks.empty() && blocks.back().size() <= carry.size()) {
+        for (auto &p : blocks.back()) {
+            if (alive[p.index]) {
+                carry.push_back(p);
+            } else {
+                --dead_count;  // tombstones are dropped while merging
+            }
+        }
+        blocks.pop_back();
+    }
+    make_tree(carry, 0, carry.size(), 0);
+    blocks.push_back(std::move(carry));
+    return index;
+}
 
-    d = dist2(branch_pt, pt);
-    dx = branch_pt.at(level) - pt.at(level);
-    dx2 = dx * dx;
+bool KDTree::remove(const size_t &index) {
+    if (index >= alive.size() || !alive[index]) {
+        return false;
+    }
+    alive[index] = 0;
+    --alive_count;
+    ++dead_count;
+    if (dead_count > alive_count) {
+        rebuild();
+    }
+    return true;
+}
 
-    KDNodePtr best_l = best;
-    double best_dist_l = best_dist;
+bool KDTree::remove(const sdpf::vec2 &pt) {
+    KDPoint best;
+    double best_dist2;
+    if (!nearest(pt, best, best_dist2) || best_dist2 > 0) {
+        return false;
+    }
+    return remove(best.index);
+}
 
-    if (d < best_dist) {
-        best_dist_l = d;
-        best_l = branch;
+void KDTree::nearest_(const sdpf::vec2 &pt,  //
+                      KDPoint &best,         //
+                      double &best_dist2,    //
+                      bool &found            //
+) const {
+    for (auto &it : blocks) {
+        search_nearest(it, alive.data(), pt, best, best_dist2, found);
     }
+}
 
-    size_t next_lv = (level + 1) % dim;
-    KDNodePtr section;
-    KDNodePtr other;
-
-    // select which branch makes sense to check
-    if (dx > 0) {
-        section = branch->left;
-        other = branch->right;
-    } else {
-        section = branch->right;
-        other = branch->left;
+bool KDTree::nearest(const sdpf::vec2 &pt,  //
+                     KDPoint &best,         //
+                     double &best_dist2     //
+) const {
+    if (empty()) {
+        return false;
     }
+    bool found = false;
+    best_dist2 = std::numeric_limits< double >::infinity();
+    nearest_(pt, best, best_dist2, found);
+    return true;
+}
 
-    // keep nearest neighbor from further down the tree
-    KDNodePtr further = nearest_(section, pt, next_lv, best_l, best_dist_l);
-    if (!further->x.empty()) {
-        double dl = dist2(further->x, pt);
-        if (dl < best_dist_l) {
-            best_dist_l = dl;
-            best_l = further;
-        }
+bool KDTree::nearest_batch(const sdpf::vec2 *pts,  //
+                           const size_t &count,    //
+                           KDPoint *best,          //
+                           double *best_dist2      //
+) const {
+    if (empty()) {
+        return false;
     }
-    // only check the other branch if it makes sense to do so
-    if (dx2 < best_dist_l) {
-        further = nearest_(other, pt, next_lv, best_l, best_dist_l);
-        if (!further->x.empty()) {
-            double dl = dist2(further->x, pt);
-            if (dl < best_dist_l) {
-                best_dist_l = dl;
-                best_l = further;
-            }
+    for (size_t i = 0; i < count; i++) {
+        bool found = false;
+        if (i > 0) {
+            // the previous result is a real point, so its distance bounds
+            // the search and neighbouring queries prune almost everything
+            best_dist2[i] = dist2(best[i - 1].pos, pts[i]);
+        } else {
+            best_dist2[i] = std::numeric_limits< double >::infinity();
         }
+        nearest_(pts[i], best[i], best_dist2[i], found);
+    }
+    return true;
+}
+
+point_t KDTree::nearest_point(const point_t &pt) const {
+    KDPoint best;
+    double best_dist2;
+    if (!nearest(to_vec2(pt), best, best_dist2)) {
+        return point_t();
     }
+    return to_point(best.pos);
+}
 
-    return best_l;
-};
-
-// default caller
-KDNodePtr KDTree::nearest_(const point_t &pt) {
-    size_t level = 0;
-    // KDNodePtr best = branch;
-    double branch_dist = dist2(point_t(*root), pt);
-    return nearest_(root,          // beginning of tree
-                    pt,            // point we are querying
-                    level,         // start from level 0
-                    root,          // best is the root
-                    branch_dist);  // best_dist = branch_dist
-};
-
-point_t KDTree::nearest_point(const point_t &pt) {
-    return point_t(*nearest_(pt));
-};
-size_t KDTree::nearest_index(const point_t &pt) {
-    return size_t(*nearest_(pt));
-};
-
-pointIndex KDTree::nearest_pointIndex(const point_t &pt) {
-    KDNodePtr Nearest = nearest_(pt);
-    return pointIndex(point_t(*Nearest), size_t(*Nearest));
+size_t KDTree::nearest_index(const point_t &pt) const {
+    KDPoint best;
+    double best_dist2;
+    if (!nearest(to_vec2(pt), best, best_dist2)) {
+        return 0;
+    }
+    return best.index;
 }
 
-pointIndexArr KDTree::neighborhood_(  //
-    const KDNodePtr &branch,          //
-    const point_t &pt,                //
-    const double &rad,                //
-    const size_t &level               //
-) {
-    double d, dx, dx2;
+pointIndex KDTree::nearest_pointIndex(const point_t &pt) const {
+    KDPoint best;
+    double best_dist2;
+    if (!nearest(to_vec2(pt), best, best_dist2)) {
+        return pointIndex(point_t(), 0);
+    }
+    return pointIndex(to_point(best.pos), best.index);
+}
 
-    if (!bool(*branch)) {
-        // branch has no point, means it is a leaf,
-        // no points to add
-        return pointIndexArr();
+size_t KDTree::knearest(const sdpf::vec2 &pt,  //
+                        const size_t &k,       //
+                        KDPoint *result,       //
+                        double *result_dist2   //
+) const {
+    size_t count = 0;
+    if (k == 0) {
+        return 0;
     }
 
-    size_t dim = pt.size();
+    for (auto &nodes : blocks) {
+        if (nodes.empty()) {
+            continue;
+        }
 
-    double r2 = rad * rad;
+        // once the heap is full its top bounds the search
+        auto out_of_reach = [&](const double &bound) {
+            return count == k && bound >= result_dist2[0];
+        };
 
-    d = dist2(point_t(*branch), pt);
-    dx = point_t(*branch).at(level) - pt.at(level);
-    dx2 = dx * dx;
+        KDFrame stack[max_depth + 1];
+        size_t top = 0;
+        stack[top++] = KDFrame{0, nodes.size(), 0, 0.};
 
-    pointIndexArr nbh, nbh_s, nbh_o;
-    if (d <= r2) {
-        nbh.push_back(pointIndex(*branch));
-    }
+        while (top > 0) {
+            const KDFrame f = stack[--top];
+            if (out_of_reach(f.bound)) {
+                continue;
+            }
 
-    //
-    KDNodePtr section;
-    KDNodePtr other;
-    if (dx > 0) {
-        section = branch->left;
-        other = branch->right;
-    } else {
-        section = branch->right;
-        other = branch->left;
-    }
+            size_t mid = f.begin + (f.end - f.begin) / 2;
+            const KDPoint &branch = nodes[mid];
+
+            if (alive[branch.index]) {
+                double d = dist2(branch.pos, pt);
+                if (count < k) {
+                    result[count] = branch;
+                    result_dist2[count] = d;
+                    heap_sift_up(result, result_dist2, count);
+                    ++count;
+                } else if (d < result_dist2[0]) {
+                    result[0] = branch;
+                    result_dist2[0] = d;
+                    heap_sift_down(result, result_dist2, 0, count);
+                }
+            }
+
+            double dx = coord(branch.pos, f.level) - coord(pt, f.level);
+            size_t next_lv = (f.level + 1) % 2;
 
-    nbh_s = neighborhood_(section, pt, rad, (level + 1) % dim);
-    nbh.insert(nbh.end(), nbh_s.begin(), nbh_s.end());
-    if (dx2 < r2) {
-        nbh_o = neighborhood_(other, pt, rad, (level + 1) % dim);
-        nbh.insert(nbh.end(), nbh_o.begin(), nbh_o.end());
+            KDFrame left{f.begin, mid, next_lv, 0.};
+            KDFrame right{mid + 1, f.end, next_lv, 0.};
+            KDFrame &section = dx > 0 ? left : right;
+            KDFrame &other = dx > 0 ? right : left;
+            other.bound = dx * dx;
+            if (other.begin < other.end && !out_of_reach(other.bound)) {
+                stack[top++] = other;
+            }
+            if (section.begin < section.end) {
+                stack[top++] = section;
+            }
+        }
     }
 
-    return nbh;
-};
+    // heap sort in place, nearest first
+    for (size_t n = count; n > 1; --n) {
+        std::swap(result[0], result[n - 1]);
+        std::swap(result_dist2[0], result_dist2[n - 1]);
+        heap_sift_down(result, result_dist2, 0, n - 1);
+    }
+    return count;
+}
 
 pointIndexArr KDTree::neighborhood(  //
     const point_t &pt,               //
-    const double &rad) {
-    size_t level = 0;
-    return neighborhood_(root, pt, rad, level);
+    const double &rad) const {
+    pointIndexArr nbh;
+    radius(to_vec2(pt), rad, [&](const KDPoint &p) {
+        nbh.push_back(pointIndex(to_point(p.pos), p.index));
+    });
+    return nbh;
 }
 
 pointVec KDTree::neighborhood_points(  //
     const point_t &pt,                 //
-    const double &rad) {
-    size_t level = 0;
-    pointIndexArr nbh = neighborhood_(root, pt, rad, level);
+    const double &rad) const {
     pointVec nbhp;
-    nbhp.resize(nbh.size());
-    std::transform(nbh.begin(), nbh.end(), nbhp.begin(),
-                   [](pointIndex x) { return x.first; });
+    radius(to_vec2(pt), rad,
+           [&](const KDPoint &p) { nbhp.push_back(to_point(p.pos)); });
     return nbhp;
 }
 
 indexArr KDTree::neighborhood_indices(  //
     const point_t &pt,                  //
-    const double &rad) {
-    size_t level = 0;
-    pointIndexArr nbh = neighborhood_(root, pt, rad, level);
+    const double &rad) const {
     indexArr nbhi;
-    nbhi.resize(nbh.size());
-    std::transform(nbh.begin(), nbh.end(), nbhi.begin(),
-                   [](pointIndex x) { return x.second; });
+    radius(to_vec2(pt), rad,
+           [&](const KDPoint &p) { nbhi.push_back(p.index); });
     return nbhi;
 }
@@ -9,122 +9,177 @@
  * It is a reimplementation of the C code using C++.
  * It also includes a few more queries than the original
  *
+ * The tree is specialised for 2D points. Nodes live in contiguous arrays
+ * in implicit (median split) order, so there are no per-node heap objects
+ * and the vec2 queries never allocate. Points can be inserted and removed,
+ * the tree is then kept as a logarithmic forest of static trees with
+ * removed points left as tombstones until enough of them pile up.
+ *
  */
 
 #include <algorithm>
-#include <functional>
-#include <memory>
+#include <cstddef>
 #include <vector>
 
+#include "vec2.hpp"
+
 using point_t = std::vector< double >;
 using indexArr = std::vector< size_t >;
 using pointIndex = typename std::pair< std::vector< double >, size_t >;
+using pointIndexArr = typename std::vector< pointIndex >;
+using pointVec = std::vector< point_t >;
 
-class KDNode {
-   public:
-    using KDNodePtr = std::shared_ptr< KDNode >;
+struct KDPoint {
+    sdpf::vec2 pos;
     size_t index;
-    point_t x;
-    KDNodePtr left;
-    KDNodePtr right;
-
-    // initializer
-    KDNode();
-    KDNode(const point_t &, const size_t &, const KDNodePtr &,
-           const KDNodePtr &);
-    KDNode(const pointIndex &, const KDNodePtr &, const KDNodePtr &);
-    ~KDNode();
-
-    // getter
-    double coord(const size_t &);
-
-    // conversions
-    explicit operator bool();
-    explicit operator point_t();
-    explicit operator size_t();
-    explicit operator pointIndex();
 };
 
-using KDNodePtr = std::shared_ptr< KDNode >;
-
-KDNodePtr NewKDNodePtr();
-
-// square euclidean distance
-inline double dist2(const point_t &, const point_t &);
-inline double dist2(const KDNodePtr &, const KDNodePtr &);
-
-// euclidean distance
-inline double dist(const point_t &, const point_t &);
-inline double dist(const KDNodePtr &, const KDNodePtr &);
-
-// Need for sorting
-class comparer {
-   public:
-    size_t idx;
-    explicit comparer(size_t idx_);
-    inline bool compare_idx(
-        const std::pair< std::vector< double >, size_t > &,  //
-        const std::pair< std::vector< double >, size_t > &   //
-    );
+// pending subtree of a traversal
+struct KDFrame {
+    size_t begin;
+    size_t end;
+    size_t level;
+    double bound;  // squared distance to the splitting line
 };
 
-using pointIndexArr = typename std::vector< pointIndex >;
-
-inline void sort_on_idx(const pointIndexArr::iterator &,  //
-                        const pointIndexArr::iterator &,  //
-                        size_t idx);
-
-using pointVec = std::vector< point_t >;
-
 class KDTree {
-    KDNodePtr root;
-    KDNodePtr leaf;
-
-    KDNodePtr make_tree(const pointIndexArr::iterator &begin,  //
-                        const pointIndexArr::iterator &end,    //
-                        const size_t &length,                  //
-                        const size_t &level                    //
-    );
+    // the forest is a list of static trees with sizes decreasing at least
+    // geometrically, each one is a flat array where the subtree stored in
+    // nodes[begin, end) has its root at mid = begin + (end - begin) / 2,
+    // the left child is [begin, mid) and the right child is [mid + 1, end)
+    using block = std::vector< KDPoint >;
+    std::vector< block > blocks;
+
+    // removed points stay in their block as tombstones until a rebuild
+    std::vector< unsigned char > alive;
+    size_t alive_count = 0;
+    size_t dead_count = 0;
+
+    // takes the points with index i at nodes[i] and builds one tree
+    void build(block &&nodes);
+    void rebuild();
 
    public:
+    // upper bound of the tree depth, sizes the traversal stacks
+    static constexpr size_t max_depth = 64;
+
     KDTree() = default;
-    explicit KDTree(pointVec point_array);
+    explicit KDTree(const pointVec &point_array);
+    explicit KDTree(const std::vector< sdpf::vec2 > &point_array);
+    // packed (x, y) pairs, e.g. straight from a memory-mapped file
+    KDTree(const double *xy, const size_t &count);
+    KDTree(const float *xy, const size_t &count);
+
+    inline size_t size() const { return alive_count; }
+    inline bool empty() const { return alive_count == 0; }
+
+    // adds a point and returns its index, amortised O(log n) merges
+    size_t insert(const sdpf::vec2 &pt);
+    // removes the point with this index, false if it is not in the tree
+    bool remove(const size_t &index);
+    // removes one point at exactly this position, false if there is none
+    bool remove(const sdpf::vec2 &pt);
 
    private:
-    KDNodePtr nearest_(           //
-        const KDNodePtr &branch,  //
-        const point_t &pt,        //
-        const size_t &level,      //
-        const KDNodePtr &best,    //
-        const double &best_dist   //
-    );
-
-    // default caller
-    KDNodePtr nearest_(const point_t &pt);
+    // bounded search, best_dist2 is an upper bound on input and the first
+    // point within it is taken, so a bound taken from a real point gives
+    // the same result (ties included) as an unbounded search
+    void nearest_(const sdpf::vec2 &pt,  //
+                  KDPoint &best,         //
+                  double &best_dist2,    //
+                  bool &found            //
+    ) const;
 
    public:
-    point_t nearest_point(const point_t &pt);
-    size_t nearest_index(const point_t &pt);
-    pointIndex nearest_pointIndex(const point_t &pt);
-
-   private:
-    pointIndexArr neighborhood_(  //
-        const KDNodePtr &branch,  //
-        const point_t &pt,        //
-        const double &rad,        //
-        const size_t &level       //
-    );
+    // non-allocating nearest neighbour query, false if the tree is empty
+    bool nearest(const sdpf::vec2 &pt,  //
+                 KDPoint &best,         //
+                 double &best_dist2     //
+    ) const;
+
+    // coherent batch query over neighbouring positions (a scan line or a
+    // tile), each search is bounded by the distance to the previous result
+    bool nearest_batch(const sdpf::vec2 *pts,  //
+                       const size_t &count,    //
+                       KDPoint *best,          //
+                       double *best_dist2      //
+    ) const;
+
+    // calls visitor(const KDPoint &) for every point within rad of pt,
+    // the walk uses a fixed stack and never allocates
+    template < class visitor_c >
+    void radius(const sdpf::vec2 &pt,     //
+                const double &rad,        //
+                const visitor_c &visitor  //
+    ) const;
+
+    // the k nearest points sorted by distance, written to caller buffers
+    // holding k entries, returns how many were found
+    size_t knearest(const sdpf::vec2 &pt,  //
+                    const size_t &k,       //
+                    KDPoint *result,       //
+                    double *result_dist2   //
+    ) const;
+
+    point_t nearest_point(const point_t &pt) const;
+    size_t nearest_index(const point_t &pt) const;
+    pointIndex nearest_pointIndex(const point_t &pt) const;
 
-   public:
     pointIndexArr neighborhood(  //
         const point_t &pt,       //
-        const double &rad);
+        const double &rad) const;
 
     pointVec neighborhood_points(  //
         const point_t &pt,         //
-        const double &rad);
+        const double &rad) const;
 
     indexArr neighborhood_indices(  //
         const point_t &pt,          //
-        const double &rad);
+        const double &rad) const;
 };
+
+template < class visitor_c >
+inline void KDTree::radius(const sdpf::vec2 &pt,     //
+                           const double &rad,        //
+                           const visitor_c &visitor  //
+) const {
+    double r2 = rad * rad;
+    for (auto &nodes : blocks) {
+        if (nodes.empty()) {
+            continue;
+        }
+
+        KDFrame stack[max_depth + 1];
+        size_t top = 0;
+        stack[top++] = KDFrame{0, nodes.size(), 0, 0.};
+
+        while (top > 0) {
+            const KDFrame f = stack[--top];
+
+            size_t mid = f.begin + (f.end - f.begin) / 2;
+            const KDPoint &branch = nodes[mid];
+
+            double dx = branch.pos.x - pt.x;
+            double dy = branch.pos.y - pt.y;
+            if (alive[branch.index] && dx * dx + dy * dy <= r2) {
+                visitor(branch);
+            }
+
+            double dl = f.level == 0 ? dx : dy;
+            size_t next_lv = (f.level + 1) % 2;
+
+            // the nearer branch is pushed last so that it is visited first,
+            // the other one only if the splitting line is within reach
+            KDFrame left{f.begin, mid, next_lv, 0.};
+            KDFrame right{mid + 1, f.end, next_lv, 0.};
+            KDFrame &section = dl > 0 ? left : right;
+            KDFrame &other = dl > 0 ? right : left;
+            if (other.begin < other.end && dl * dl <= r2) {
+                stack[top++] = other;
+            }
+            if (section.begin < section.end) {
+                stack[top++] = section;
+            }
+        }
+    }
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <deque>
 #include "navmesh.hpp"
 //寻路
 namespace sdpf {
@@ -20,12 +21,9 @@ struct context {  //寻路context
     ivec2 target;
     bool failed = false;
     double minPathWidth = 0;
-    std::vector<node*> nodes;  //内存管理用的
-    ~context() {
-        for (auto it : nodes) {
-            delete it;
-        }
-        nodes.clear();
+    std::deque<node> nodes;  //节点池，deque追加时地址不变
+    inline node* alloc() {
+        return &nodes.emplace_back();
     }
 };
 
@@ -35,14 +33,16 @@ inline void start(context& ctx,
                   navmesh::node* target,
                   const callback_c& callback,
                   int it_count = 512) {
-    auto st = new node;
+    ctx.openlist.clear();
+    ctx.closelist.clear();
+    ctx.nodes.clear();
+    auto st = ctx.alloc();
     st->f = 0;
     st->g = 0;
     st->h = 0;
     st->parent = NULL;
     st->position = begin->position;
     st->navNode = begin;
-    ctx.nodes.push_back(st);
     ctx.processing = st;
     ctx.result = NULL;
     ctx.failed = false;
@@ -57,7 +57,8 @@ inline void start(context& ctx,
     }
 }
 
-inline void buildRoad(context& ctx, std::function<void(navmesh::node*)> callback) {
+template <class callback_c>
+inline void buildRoad(context& ctx, const callback_c& callback) {
     if (ctx.result) {
         auto p = ctx.result;
         while (p) {
@@ -92,8 +93,7 @@ inline void step(context& ctx, const callback_c& callback) {
             return;
         if (ctx.closelist.find(targetNavNode) != ctx.closelist.end())
             return;
-        auto p = new node;
-        ctx.nodes.push_back(p);
+        auto p = ctx.alloc();
         p->parent = ctx.processing;
         p->position = targetNavNode->position;
         p->navNode = targetNavNode;
@@ -156,6 +156,191 @@ inline void step(context& ctx, const callback_c& callback) {
     }
 }
 
+//按节点id索引的图搜索
+//每个节点的状态存在按id下标的数组里，开放列表为带位置索引的4叉堆（支持降低键值），
+//记录本次搜索碰过的下标，下次搜索只重置这些位置，适合每帧大量的单次查询
+//mesh.nodes的id从1开始，pathfinding中的临时起点、终点id为-1、-2，也有自己的下标
+struct graph {
+    static constexpr int arity = 4;
+    std::vector<double> g;                 //起始点到当前点实际代价
+    std::vector<double> f;                 //估计值
+    std::vector<int32_t> parent;           //父节点下标，起点为-1
+    std::vector<int32_t> heapPos;          //在堆中的位置，-1为不在堆中
+    std::vector<uint8_t> state;            //0未访问，1在开放列表中，2已关闭
+    std::vector<navmesh::node*> navNodes;  //下标对应的导航节点
+    std::vector<int32_t> heap;             //按f排序的小根堆，元素为下标
+    std::vector<int32_t> touched;          //本次搜索碰过的下标
+    int32_t result = -1;                   //找到的终点下标
+    bool failed = false;
+
+    static inline int32_t slot(const navmesh::node* n) {
+        return n->id > 0 ? n->id + 1 : -n->id - 1;
+    }
+    //按节点数预先分配，避免搜索中扩容
+    inline void reserve(size_t nodeCount) {
+        size_t len = nodeCount + 2;
+        if (g.size() < len) {
+            g.resize(len);
+            f.resize(len);
+            parent.resize(len);
+            heapPos.resize(len, -1);
+            state.resize(len, 0);
+            navNodes.resize(len, nullptr);
+        }
+    }
+    //只重置上次搜索碰过的位置
+    inline void reset() {
+        for (auto i : touched) {
+            state[i] = 0;
+            heapPos[i] = -1;
+        }
+        touched.clear();
+        heap.clear();
+        result = -1;
+        failed = false;
+    }
+
+    inline bool heapLess(int32_t a, int32_t b) const {
+        return f[a] < f[b] || (f[a] == f[b] && a < b);
+    }
+    inline void siftUp(int32_t pos) {
+        int32_t item = heap[pos];
+        while (pos > 0) {
+            int32_t up = (pos - 1) / arity;
+            if (!heapLess(item, heap[up])) {
+                break;
+            }
+            heap[pos] = heap[up];
+            heapPos[heap[pos]] = pos;
+            pos = up;
+        }
+        heap[pos] = item;
+        heapPos[item] = pos;
+    }
+    inline void siftDown(int32_t pos) {
+        int32_t item = heap[pos];
+        const int32_t len = heap.size();
+        while (true) {
+            int32_t first = pos * arity + 1;
+            if (first >= len) {
+                break;
+            }
+            int32_t best = first;
+            int32_t last = std::min(first + arity, len);
+            for (int32_t c = first + 1; c < last; ++c) {
+                if (heapLess(heap[c], heap[best])) {
+                    best = c;
+                }
+            }
+            if (!heapLess(heap[best], item)) {
+                break;
+            }
+            heap[pos] = heap[best];
+            heapPos[heap[pos]] = pos;
+            pos = best;
+        }
+        heap[pos] = item;
+        heapPos[item] = pos;
+    }
+    inline void push(int32_t i) {
+        heap.push_back(i);
+        siftUp(heap.size() - 1);
+    }
+    inline int32_t pop() {
+        int32_t top = heap[0];
+        heapPos[top] = -1;
+        int32_t last = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) {
+            heap[0] = last;
+            siftDown(0);
+        }
+        return top;
+    }
+};
+
+//搜索从begin到target的路线，callback(navNode, emit)与start相同，emit(targetNavNode, length)
+//弹出target时结束，路线为最短路，it_count为最多展开的节点数，小于0不限制
+template <class callback_c>
+inline bool search(graph& ctx,
+                   navmesh::node* begin,
+                   navmesh::node* target,
+                   const callback_c& callback,
+                   int it_count = -1) {
+    ctx.reset();
+    auto h = [&](const ivec2& p) {
+        double x = p.x - target->position.x;
+        double y = p.y - target->position.y;
+        return sqrt(x * x + y * y);
+    };
+    auto visit = [&](navmesh::node* n) {
+        int32_t i = graph::slot(n);
+        if ((size_t)i >= ctx.g.size()) {
+            ctx.reserve(std::max<size_t>(i, ctx.g.size() * 2));
+        }
+        if (ctx.state[i] == 0) {
+            ctx.touched.push_back(i);
+            ctx.navNodes[i] = n;
+        }
+        return i;
+    };
+    int32_t bi = visit(begin);
+    ctx.g[bi] = 0;
+    ctx.f[bi] = h(begin->position);
+    ctx.parent[bi] = -1;
+    ctx.state[bi] = 1;
+    ctx.push(bi);
+
+    int num = 0;
+    while (!ctx.heap.empty()) {
+        int32_t current = ctx.pop();
+        ctx.state[current] = 2;
+        navmesh::node* n = ctx.navNodes[current];
+        if (n == target) {
+            ctx.result = current;
+            return true;
+        }
+        if (it_count >= 0 && num >= it_count) {
+            break;
+        }
+        ++num;
+        double gc = ctx.g[current];
+        callback(n, [&](navmesh::node* next, double length) {
+            int32_t ni = visit(next);
+            if (ctx.state[ni] == 2) {
+                return;
+            }
+            double ng = gc + length;
+            if (ctx.state[ni] == 1) {
+                if (ctx.g[ni] <= ng) {
+                    return;
+                }
+                ctx.g[ni] = ng;
+                ctx.f[ni] = ng + h(next->position);
+                ctx.parent[ni] = current;
+                ctx.siftUp(ctx.heapPos[ni]);  //降低键值
+                return;
+            }
+            ctx.state[ni] = 1;
+            ctx.g[ni] = ng;
+            ctx.f[ni] = ng + h(next->position);
+            ctx.parent[ni] = current;
+            ctx.push(ni);
+        });
+    }
+    ctx.failed = true;
+    return false;
+}
+//从终点回溯到起点
+template <class callback_c>
+inline void buildRoad(graph& ctx, const callback_c& callback) {
+    int32_t p = ctx.result;
+    while (p >= 0) {
+        callback(ctx.navNodes[p]);
+        p = ctx.parent[p];
+    }
+}
+
 }  // namespace astar_node
 
 }  // namespace sdpf
\ No newline at end of file
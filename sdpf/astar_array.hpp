@@ -1,4 +1,7 @@
 #pragma once
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include "vec2.hpp"
@@ -145,4 +148,139 @@ inline void step(context& ctx, const callback_c& callback) {
         }
     }
 }
+//基于二叉堆和稠密数组的网格A*
+//g值、父节点、状态都按格子存放，用代数（generation）区分不同的查询，
+//重复使用时不需要清空和重新分配，每个线程使用自己的grid
+//数组只覆盖窗口[origin, origin + (width, height))，搜索不会离开窗口，
+//窗口取搜索范围的包围盒时，内存与路线附近的面积成正比，与地图大小无关
+struct grid {
+    int width = 0;  //窗口大小
+    int height = 0;
+    ivec2 origin{0, 0};             //窗口左上角在地图中的位置
+    std::vector<float> g;           //起始点到当前点实际代价
+    std::vector<int32_t> parent;    //父节点下标，起点为-1
+    std::vector<uint32_t> state;    //2*generation为在开放列表中，2*generation+1为已关闭
+    std::vector<std::pair<float, int32_t>> heap;  //(f, 下标)小根堆，过期的项出堆时跳过
+    uint32_t generation = 0;
+    int32_t result = -1;  //找到的终点下标
+    bool failed = false;
+    int32_t beginIndex = -1;
+
+    inline grid() = default;
+    inline grid(int w, int h) {
+        setWindow(ivec2(0, 0), ivec2(w - 1, h - 1));
+    }
+    //把窗口设为[begin, end]（闭区间），数组只在变大时重新分配
+    inline void setWindow(const ivec2& begin, const ivec2& end) {
+        origin = begin;
+        width = std::max(end.x - begin.x + 1, 0);
+        height = std::max(end.y - begin.y + 1, 0);
+        size_t len = (size_t)width * height;
+        if (len > state.size()) {
+            g.resize(len);
+            parent.resize(len);
+            state.assign(len, 0);
+            generation = 0;
+        }
+    }
+    inline bool contains(const ivec2& p) const {
+        return p.x >= origin.x && p.y >= origin.y &&
+               p.x < origin.x + width && p.y < origin.y + height;
+    }
+    inline int32_t index(const ivec2& p) const {
+        return (p.y - origin.y) * width + (p.x - origin.x);
+    }
+    inline ivec2 position(int32_t i) const {
+        return ivec2(i % width + origin.x, i / width + origin.y);
+    }
+};
+
+//搜索从begin到target的路线，callback(pos, emit)列出pos的邻居
+//除起点外第一个距target不超过1的格子为终点（与start相同），it_count为最多展开的格子数，小于0不限制
+//窗口外的格子不会被展开
+template <class callback_c>
+inline bool search(grid& ctx,
+                   const ivec2& begin,
+                   const ivec2& target,
+                   const callback_c& callback,
+                   int it_count = -1) {
+    ctx.result = -1;
+    ctx.failed = true;
+    if (!ctx.contains(begin)) {
+        return false;
+    }
+    ctx.generation += 1;
+    if (ctx.generation >= 0x7fffffff) {
+        //代数用完，清空状态
+        std::fill(ctx.state.begin(), ctx.state.end(), 0);
+        ctx.generation = 1;
+    }
+    const uint32_t openMark = ctx.generation * 2;
+    const uint32_t closeMark = openMark + 1;
+    auto heapLess = [](const std::pair<float, int32_t>& a, const std::pair<float, int32_t>& b) {
+        return a.first > b.first || (a.first == b.first && a.second > b.second);
+    };
+    auto h = [&](const ivec2& p) {
+        double x = p.x - target.x;
+        double y = p.y - target.y;
+        return (float)sqrt(x * x + y * y);
+    };
+    ctx.heap.clear();
+    ctx.failed = false;
+    ctx.beginIndex = ctx.index(begin);
+    ctx.g[ctx.beginIndex] = 0;
+    ctx.parent[ctx.beginIndex] = -1;
+    ctx.state[ctx.beginIndex] = openMark;
+    ctx.heap.push_back(std::make_pair(h(begin), ctx.beginIndex));
+
+    int num = 0;
+    while (!ctx.heap.empty()) {
+        std::pop_heap(ctx.heap.begin(), ctx.heap.end(), heapLess);
+        int32_t current = ctx.heap.back().second;
+        ctx.heap.pop_back();
+        if (ctx.state[current] == closeMark) {
+            continue;
+        }
+        ctx.state[current] = closeMark;
+        ivec2 pos = ctx.position(current);
+        if (current != ctx.beginIndex && heuristic(pos, target) <= 1) {
+            ctx.result = current;
+            return true;
+        }
+        if (it_count >= 0 && num >= it_count) {
+            break;
+        }
+        ++num;
+        float gc = ctx.g[current];
+        callback(pos, [&](const ivec2& next) {
+            if (!ctx.contains(next)) {
+                return;
+            }
+            int32_t ni = ctx.index(next);
+            if (ctx.state[ni] == closeMark) {
+                return;
+            }
+            float ng = gc + (float)(next - pos).norm();
+            if (ctx.state[ni] == openMark && ctx.g[ni] <= ng) {
+                return;
+            }
+            ctx.state[ni] = openMark;
+            ctx.g[ni] = ng;
+            ctx.parent[ni] = current;
+            ctx.heap.push_back(std::make_pair(ng + h(next), ni));
+            std::push_heap(ctx.heap.begin(), ctx.heap.end(), heapLess);
+        });
+    }
+    ctx.failed = true;
+    return false;
+}
+//从终点回溯到起点
+template <class callback_c>
+inline void buildRoad(grid& ctx, const callback_c& callback) {
+    int32_t p = ctx.result;
+    while (p >= 0) {
+        callback(ctx.position(p));
+        p = ctx.parent[p];
+    }
+}
 }  // namespace sdpf::astar_array
\ No newline at end of file
@@ -0,0 +1,148 @@
+#pragma once
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "navmesh.hpp"
+//烘焙流程
+//按顺序执行各阶段，记录每个阶段的耗时、线程数、内存峰值和产出数量，可输出为JSON
+namespace sdpf::bake {
+
+struct options {
+    double minPathWith = 8;  //最小路宽
+    bool eikonal = false;    //上路流场使用buildNavFlowFieldEikonal
+    bool compress = false;   //完成后转换为紧凑存储
+    bool keepIslands = false;  //保留所有山脊，不只保留最大的一块（分块烘焙时用）
+    bool thinning = false;     //骨架使用buildIdMapThinning
+    bool borderNodes = false;  //骨架碰到地图边缘的地方也是节点（分块烘焙时用）
+};
+
+struct stage {
+    std::string name;
+    double seconds = 0;        //墙上时间
+    int threads = 0;           //openmp线程数
+    int64_t peakMemoryKB = 0;  //阶段结束时进程的内存峰值（getrusage的ru_maxrss）
+    std::vector<std::pair<std::string, int64_t>> counts{};  //产出数量
+};
+
+struct report {
+    int width = 0;
+    int height = 0;
+    double minPathWith = 0;
+    double seconds = 0;  //总耗时
+    std::vector<stage> stages{};
+
+    inline std::string toJSON() const {
+        std::string res;
+        char buf[256];
+        snprintf(buf, sizeof(buf),
+                 "{\"width\":%d,\"height\":%d,\"minPathWith\":%.17g,\"seconds\":%.6f,\"stages\":[",
+                 width, height, minPathWith, seconds);
+        res += buf;
+        for (size_t i = 0; i < stages.size(); ++i) {
+            auto& s = stages[i];
+            snprintf(buf, sizeof(buf),
+                     "%s{\"name\":\"%s\",\"seconds\":%.6f,\"threads\":%d,\"peakMemoryKB\":%lld",
+                     i ? "," : "", s.name.c_str(), s.seconds, s.threads, (long long)s.peakMemoryKB);
+            res += buf;
+            for (auto& c : s.counts) {
+                snprintf(buf, sizeof(buf), ",\"%s\":%lld", c.first.c_str(), (long long)c.second);
+                res += buf;
+            }
+            res += "}";
+        }
+        res += "]}";
+        return res;
+    }
+};
+
+inline int64_t peakMemoryKB() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+    return usage.ru_maxrss;  //Linux下单位为KB
+}
+
+//执行一个阶段并记录，callback(stage&)可在stage.counts中写入产出数量
+template <class callback_c>
+inline void runStage(report& rep, const char* name, const callback_c& callback) {
+    stage s;
+    s.name = name;
+    s.threads = omp_get_max_threads();
+    double begin = omp_get_wtime();
+    callback(s);
+    s.seconds = omp_get_wtime() - begin;
+    s.peakMemoryKB = peakMemoryKB();
+    rep.seconds += s.seconds;
+    rep.stages.push_back(std::move(s));
+}
+
+//完整的烘焙：sdf、山脊（或细化的骨架）、删除孤立路线、节点与连线、上路流场
+inline report run(navmesh::navmesh& mesh, const KDTree& tree, const options& opt = options()) {
+    report rep;
+    rep.width = mesh.width;
+    rep.height = mesh.height;
+    rep.minPathWith = opt.minPathWith;
+    std::vector<ivec2> starts;
+
+    runStage(rep, "buildSdfMap", [&](stage& s) {
+        navmesh::buildSdfMap(mesh, tree);
+        s.counts.emplace_back("points", (int64_t)tree.size());
+    });
+    runStage(rep, "buildIdMap", [&](stage& s) {
+        if (opt.thinning) {
+            navmesh::buildIdMapThinning(mesh, starts, opt.minPathWith);
+        } else {
+            navmesh::buildIdMap(mesh, starts, opt.minPathWith);
+        }
+        s.counts.emplace_back("ridge", (int64_t)starts.size());
+    });
+    runStage(rep, "removeWaste", [&](stage& s) {
+        if (opt.keepIslands) {
+            for (auto& it : starts) {
+                mesh.idMap.at(it.x, it.y) = -2;
+            }
+        } else {
+            navmesh::removeWaste(mesh, starts);
+        }
+        s.counts.emplace_back("ridge", (int64_t)starts.size());
+    });
+    runStage(rep, "buildNodeBlock", [&](stage& s) {
+        navmesh::buildNodeBlock(mesh, starts, 2, opt.thinning, opt.borderNodes);
+        int64_t pathPoints = 0;
+        for (auto& it : mesh.ways) {
+            pathPoints += it.second->maxPath.size();
+        }
+        s.counts.emplace_back("nodes", (int64_t)mesh.nodes.size());
+        s.counts.emplace_back("ways", (int64_t)mesh.ways.size());
+        s.counts.emplace_back("pathPoints", pathPoints);
+    });
+    runStage(rep, "buildNavFlowField", [&](stage& s) {
+        if (opt.eikonal) {
+            navmesh::buildNavFlowFieldEikonal(mesh, opt.minPathWith);
+        } else {
+            navmesh::buildNavFlowField(mesh, opt.minPathWith);
+        }
+        int64_t reached = 0;
+        for (int y = 0; y < mesh.height; ++y) {
+            for (int x = 0; x < mesh.width; ++x) {
+                if (mesh.pathNavMap.at(x, y).cost >= 0) {
+                    ++reached;
+                }
+            }
+        }
+        s.counts.emplace_back("reached", reached);
+    });
+    if (opt.compress) {
+        runStage(rep, "compress", [&](stage& s) {
+            navmesh::compress(mesh);
+        });
+    }
+    return rep;
+}
+
+}  // namespace sdpf::bake
@@ -0,0 +1,126 @@
+#pragma once
+#include <omp.h>
+#include <stdint.h>
+#include <vector>
+#include "field.hpp"
+#include "vec2.hpp"
+//连通域标记（8邻域，两遍扫描+并查集）
+//第一遍按行分段并行，每段内部逐行扫描合并，段与段之间的边界行最后合并
+namespace sdpf::ccl {
+
+//并查集，根总是集合里下标最小的元素，所以parent[i] <= i
+inline int32_t findRoot(int32_t* parent, int32_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+inline void unite(int32_t* parent, int32_t a, int32_t b) {
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b) {
+        parent[b] = a;
+    } else if (b < a) {
+        parent[a] = b;
+    }
+}
+
+//mask非0的格子参与标记，labels输出连通域编号（从1开始，背景为0）
+//编号按连通域中最小的点（先比较x再比较y）排序，seeds输出这些点，返回连通域数量
+inline int label(field<uint8_t>& mask, field<int32_t>& labels, std::vector<ivec2>& seeds) {
+    const int w = mask.width;
+    const int h = mask.height;
+    const uint8_t* m = mask.data;
+    std::vector<int32_t> parentBuffer((size_t)w * h);
+    int32_t* parent = parentBuffer.data();
+    std::vector<int> stripBegin;
+
+    //第一遍：每个线程负责连续的若干行
+#pragma omp parallel
+    {
+        int threads = omp_get_num_threads();
+        int thread_id = omp_get_thread_num();
+#pragma omp single
+        stripBegin.assign(threads + 1, h);
+        int row_begin = (int)((long)h * thread_id / threads);
+        int row_end = (int)((long)h * (thread_id + 1) / threads);
+        stripBegin[thread_id] = row_begin;
+        for (int y = row_begin; y < row_end; ++y) {
+            for (int x = 0; x < w; ++x) {
+                int32_t index = y * w + x;
+                parent[index] = index;
+                if (!m[index]) {
+                    continue;
+                }
+                if (x > 0 && m[index - 1]) {
+                    unite(parent, index, index - 1);
+                }
+                if (y > row_begin) {
+                    int32_t up = index - w;
+                    if (x > 0 && m[up - 1]) {
+                        unite(parent, index, up - 1);
+                    }
+                    if (m[up]) {
+                        unite(parent, index, up);
+                    }
+                    if (x < w - 1 && m[up + 1]) {
+                        unite(parent, index, up + 1);
+                    }
+                }
+            }
+        }
+    }
+
+    //合并各段的边界行
+    for (size_t s = 1; s + 1 < stripBegin.size(); ++s) {
+        int y = stripBegin[s];
+        if (y <= 0 || y >= h || y == stripBegin[s - 1]) {
+            continue;
+        }
+        for (int x = 0; x < w; ++x) {
+            int32_t index = y * w + x;
+            if (!m[index]) {
+                continue;
+            }
+            int32_t up = index - w;
+            if (x > 0 && m[up - 1]) {
+                unite(parent, index, up - 1);
+            }
+            if (m[up]) {
+                unite(parent, index, up);
+            }
+            if (x < w - 1 && m[up + 1]) {
+                unite(parent, index, up + 1);
+            }
+        }
+    }
+
+    //压平：parent[i] <= i，按下标顺序一遍即可全部指向根
+    const int32_t len = w * h;
+    for (int32_t i = 0; i < len; ++i) {
+        parent[i] = parent[parent[i]];
+    }
+
+    //第二遍：按列扫描分配最终编号，根所在格子暂存该连通域的编号
+    labels.setAll(0);
+    seeds.clear();
+    int count = 0;
+    for (int x = 0; x < w; ++x) {
+        for (int y = 0; y < h; ++y) {
+            int32_t index = y * w + x;
+            if (!m[index]) {
+                continue;
+            }
+            int32_t root = parent[index];
+            if (labels.data[root] == 0) {
+                labels.data[root] = ++count;
+                seeds.push_back(ivec2(x, y));
+            }
+            labels.data[index] = labels.data[root];
+        }
+    }
+    return count;
+}
+
+}  // namespace sdpf::ccl
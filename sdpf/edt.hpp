@@ -0,0 +1,107 @@
+#pragma once
+#include <omp.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "field.hpp"
+//欧氏距离变换（Felzenszwalb/Meijster可分离算法）
+//先对每一列求最近站点所在的行，再对每一行求抛物线下包络
+//耗时为O(width*height)，与站点数量无关
+namespace sdpf::edt {
+
+//sites：每个格子上的站点编号，小于0为空
+//nearest：输出每个格子最近站点的编号，没有站点时为-1
+inline void transform(field<int32_t>& sites, field<int32_t>& nearest) {
+    const int width = sites.width;
+    const int height = sites.height;
+    field<int32_t> colNearest(width, height);  //同一列中最近站点所在的行
+
+    //列扫描：按行推进，每个线程负责一段连续的列，访存是连续的
+#pragma omp parallel
+    {
+        int threads = omp_get_num_threads();
+        int thread_id = omp_get_thread_num();
+        int col_begin = (int)((long)width * thread_id / threads);
+        int col_end = (int)((long)width * (thread_id + 1) / threads);
+        for (int j = 0; j < height; ++j) {
+            int32_t* row = &colNearest.data[j * width];
+            const int32_t* row_sites = &sites.data[j * width];
+            const int32_t* row_last = j > 0 ? &colNearest.data[(j - 1) * width] : nullptr;
+            for (int i = col_begin; i < col_end; ++i) {
+                if (row_sites[i] >= 0) {
+                    row[i] = j;
+                } else {
+                    row[i] = row_last ? row_last[i] : -1;
+                }
+            }
+        }
+        for (int j = height - 2; j >= 0; --j) {
+            int32_t* row = &colNearest.data[j * width];
+            const int32_t* row_next = &colNearest.data[(j + 1) * width];
+            for (int i = col_begin; i < col_end; ++i) {
+                int down = row_next[i];
+                if (down > j && (row[i] < 0 || down - j < j - row[i])) {
+                    row[i] = down;
+                }
+            }
+        }
+    }
+
+    //行扫描：一维抛物线下包络
+#pragma omp parallel
+    {
+        std::vector<double> f(width);
+        std::vector<int> v(width);
+        std::vector<double> z(width + 1);
+#pragma omp for
+        for (int j = 0; j < height; ++j) {
+            const int32_t* row = &colNearest.data[j * width];
+            int32_t* out = &nearest.data[j * width];
+            int k = -1;
+            for (int q = 0; q < width; ++q) {
+                if (row[q] < 0) {
+                    continue;
+                }
+                double dy = row[q] - j;
+                f[q] = dy * dy;
+                if (k < 0) {
+                    k = 0;
+                    v[0] = q;
+                    z[0] = -std::numeric_limits<double>::infinity();
+                    z[1] = std::numeric_limits<double>::infinity();
+                    continue;
+                }
+                double s;
+                while (true) {
+                    int p = v[k];
+                    s = ((f[q] + (double)q * q) - (f[p] + (double)p * p)) / (2. * (q - p));
+                    if (s > z[k]) {
+                        break;
+                    }
+                    --k;
+                }
+                ++k;
+                v[k] = q;
+                z[k] = s;
+                z[k + 1] = std::numeric_limits<double>::infinity();
+            }
+            if (k < 0) {
+                //整行所在的列都没有站点
+                for (int i = 0; i < width; ++i) {
+                    out[i] = -1;
+                }
+                continue;
+            }
+            k = 0;
+            for (int i = 0; i < width; ++i) {
+                while (z[k + 1] < i) {
+                    ++k;
+                }
+                int col = v[k];
+                out[i] = sites.data[row[col] * width + col];
+            }
+        }
+    }
+}
+
+}  // namespace sdpf::edt
@@ -0,0 +1,105 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <queue>
+#include <vector>
+#include "field.hpp"
+#include "vec2.hpp"
+//程函方程|∇T| = slowness的快速行进法（Fast Marching）
+//从种子点向外推进窄带，每个格子只确定一次，耗时O(n log n)
+//一阶迎风格式，只用4邻域，结果接近欧氏距离（按slowness加权）
+namespace sdpf::eikonal {
+
+//由x方向和y方向较小的已确定值a、b求解一阶迎风格式
+inline double solve(double a, double b, double s) {
+    if (a > b) {
+        std::swap(a, b);
+    }
+    if (b - a >= s) {  //只有一个方向起作用
+        return a + s;
+    }
+    return (a + b + sqrt(2 * s * s - (b - a) * (b - a))) * 0.5;
+}
+
+//time：输出到达时间，无法到达为INFINITY
+//slowness：每个格子的慢度（速度的倒数），需大于0，INFINITY为不可通过
+//seeds：(位置, 初始时间)，用于局部重算时把区域边缘的已知值作为种子
+inline void march(field<double>& time,
+                  field<double>& slowness,
+                  const std::vector<std::pair<ivec2, double>>& seeds) {
+    const int w = time.width;
+    const int h = time.height;
+    field<uint8_t> accepted(w, h);
+    accepted.setAll(0);
+    time.setAll(INFINITY);
+
+    using item_t = std::pair<double, int32_t>;  //(时间, 下标)，过期的项出堆时跳过
+    std::priority_queue<item_t, std::vector<item_t>, std::greater<item_t>> band;
+    for (auto& [p, value] : seeds) {
+        if (p.x >= 0 && p.y >= 0 && p.x < w && p.y < h) {
+            int32_t index = p.y * w + p.x;
+            if (value < time.data[index]) {
+                time.data[index] = value;
+                band.push(item_t(value, index));
+            }
+        }
+    }
+
+    const double* t = time.data;
+    while (!band.empty()) {
+        auto [value, index] = band.top();
+        band.pop();
+        if (accepted.data[index] || value > t[index]) {
+            continue;
+        }
+        accepted.data[index] = 1;
+        int x = index % w;
+        int y = index / w;
+        const int nx[4] = {x - 1, x + 1, x, x};
+        const int ny[4] = {y, y, y - 1, y + 1};
+        for (int k = 0; k < 4; ++k) {
+            if (nx[k] < 0 || ny[k] < 0 || nx[k] >= w || ny[k] >= h) {
+                continue;
+            }
+            int32_t n = ny[k] * w + nx[k];
+            double s = slowness.data[n];
+            if (accepted.data[n] || !(s < INFINITY)) {
+                continue;
+            }
+            //只用已确定的邻居
+            double a = INFINITY, b = INFINITY;
+            if (nx[k] > 0 && accepted.data[n - 1]) {
+                a = t[n - 1];
+            }
+            if (nx[k] < w - 1 && accepted.data[n + 1]) {
+                a = std::min(a, t[n + 1]);
+            }
+            if (ny[k] > 0 && accepted.data[n - w]) {
+                b = t[n - w];
+            }
+            if (ny[k] < h - 1 && accepted.data[n + w]) {
+                b = std::min(b, t[n + w]);
+            }
+            double v = solve(a, b, s);
+            if (v < t[n]) {
+                time.data[n] = v;
+                band.push(item_t(v, n));
+            }
+        }
+    }
+}
+
+//种子的时间都为0
+inline void march(field<double>& time,
+                  field<double>& slowness,
+                  const std::vector<ivec2>& seeds) {
+    std::vector<std::pair<ivec2, double>> valued;
+    valued.reserve(seeds.size());
+    for (auto& p : seeds) {
+        valued.emplace_back(p, 0.);
+    }
+    march(time, slowness, valued);
+}
+
+}  // namespace sdpf::eikonal
@@ -1,21 +1,84 @@
 #pragma once
 #include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
 #include <stdexcept>
 #include "vec2.hpp"
 
 //离散场
 namespace sdpf {
 
-template <typename T>
+//内存布局，决定(x,y)在data中的位置
+namespace layout {
+
+//逐行存储
+struct rowMajor {
+    static constexpr int tileSize = 8;  //只用于分块遍历
+    static inline size_t size(int w, int h) {
+        return (size_t)w * h;
+    }
+    static inline size_t index(int x, int y, int w, int h) {
+        return (size_t)y * w + x;
+    }
+};
+
+//N*N分块存储，块内逐行，3x3模板和BFS大多落在同一块内
+//宽高按N补齐，N需为2的幂
+template <int N = 8>
+struct tiled {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "tile size must be a power of two");
+    static constexpr int tileSize = N;
+    static inline size_t size(int w, int h) {
+        size_t tw = (w + N - 1) / N;
+        size_t th = (h + N - 1) / N;
+        return tw * th * N * N;
+    }
+    static inline size_t index(int x, int y, int w, int h) {
+        size_t tw = (w + N - 1) / N;
+        size_t tile = (size_t)(y / N) * tw + (x / N);
+        return tile * N * N + (y % N) * N + (x % N);
+    }
+};
+
+//Z序（Morton）存储，x、y的二进制位交错
+//宽高差别很大时补齐的空间较多
+struct morton {
+    static constexpr int tileSize = 8;
+    static inline size_t spread(uint32_t v) {
+        uint64_t r = v;
+        r = (r | (r << 16)) & 0x0000FFFF0000FFFFull;
+        r = (r | (r << 8)) & 0x00FF00FF00FF00FFull;
+        r = (r | (r << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        r = (r | (r << 2)) & 0x3333333333333333ull;
+        r = (r | (r << 1)) & 0x5555555555555555ull;
+        return r;
+    }
+    static inline size_t size(int w, int h) {
+        if (w <= 0 || h <= 0) {
+            return 0;
+        }
+        //编码对x、y都单调，最大的编码在右下角
+        return index(w - 1, h - 1, w, h) + 1;
+    }
+    static inline size_t index(int x, int y, int w, int h) {
+        return spread(x) | (spread(y) << 1);
+    }
+};
+
+}  // namespace layout
+
+template <typename T, typename layout_t = layout::rowMajor>
 struct field {  //运行阶段为只读数据结构
     T* data = nullptr;
     int width = 0;
     int height = 0;
 
     using element_t = T;
+    using layout_type = layout_t;
 
     inline field(int w, int h) {
-        data = new T[w * h];
+        data = new T[layout_t::size(w, h)];
         width = w;
         height = h;
     }
@@ -28,10 +91,25 @@ struct field {  //运行阶段为只读数据结构
         height = 0;
     }
 
+    //释放数据，之后宽高为0
+    inline void release() {
+        if (data) {
+            delete[] data;
+        }
+        data = nullptr;
+        width = 0;
+        height = 0;
+    }
+
+    //data的元素个数（含布局补齐的部分）
+    inline size_t size() const {
+        return layout_t::size(width, height);
+    }
+
     inline void setAll(T v) {
         if (data) {
-            int len = width * height;
-            for (int i = 0; i < len; ++i) {
+            size_t len = size();
+            for (size_t i = 0; i < len; ++i) {
                 data[i] = v;
             }
         }
@@ -64,8 +142,47 @@ struct field {  //运行阶段为只读数据结构
         if (ix < 0 || iy < 0 || ix >= width || iy >= height) {
             throw std::out_of_range("坐标超出");
         }
-        return data[iy * width + ix];
+        return data[layout_t::index(ix, iy, width, height)];
+    }
+
+    //不检查边界，调用者保证坐标在地图内
+    inline T& atUnchecked(int ix, int iy) {
+        return data[layout_t::index(ix, iy, width, height)];
+    }
+
+    //按块遍历，callback(x0, y0, x1, y1)，块为[x0,x1)*[y0,y1)
+    //块的大小与布局一致，块的数量可用于并行划分
+    inline int tilesX() const {
+        return (width + layout_t::tileSize - 1) / layout_t::tileSize;
+    }
+    inline int tilesY() const {
+        return (height + layout_t::tileSize - 1) / layout_t::tileSize;
+    }
+    template <class callback_c>
+    inline void forTile(int tile, const callback_c& callback) const {
+        const int n = layout_t::tileSize;
+        int x0 = (tile % tilesX()) * n;
+        int y0 = (tile / tilesX()) * n;
+        callback(x0, y0, std::min(x0 + n, width), std::min(y0 + n, height));
+    }
+    template <class callback_c>
+    inline void forEachTile(const callback_c& callback) const {
+        int count = tilesX() * tilesY();
+        for (int tile = 0; tile < count; ++tile) {
+            forTile(tile, callback);
+        }
+    }
+    //按块的顺序访问每个格子，callback(x, y, T&)
+    template <class callback_c>
+    inline void forEach(const callback_c& callback) {
+        forEachTile([&](int x0, int y0, int x1, int y1) {
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    callback(x, y, atUnchecked(x, y));
+                }
+            }
+        });
     }
 };
 
-}  // namespace sdpf
\ No newline at end of file
+}  // namespace sdpf
@@ -0,0 +1,93 @@
+#pragma once
+#include <math.h>
+#include <omp.h>
+#include "field.hpp"
+#include "sdf.hpp"
+#include "vec2.hpp"
+//梯度场（法线场）
+//每个格子保存指向最近障碍物的单位向量和到它的距离，按分量分开存储（SoA），
+//一次并行计算，山脊检测、路线优化、避障转向直接读取，不用在内层循环里重复归一化
+namespace sdpf::gradient {
+
+struct gradientField {
+    field<double> nx;   //单位法线x分量（距离为0时为0）
+    field<double> ny;   //单位法线y分量
+    field<double> mag;  //距离
+    int width = 0;
+    int height = 0;
+
+    inline gradientField(int w, int h)
+        : nx(w, h), ny(w, h), mag(w, h) {
+        width = w;
+        height = h;
+    }
+
+    inline vec2 normal(int x, int y) {
+        int i = y * width + x;
+        return vec2(nx.data[i], ny.data[i]);
+    }
+    //取最近的格子，超出地图时截断到边缘
+    inline vec2 normal(const vec2& p) {
+        int x = std::clamp((int)round(p.x), 0, width - 1);
+        int y = std::clamp((int)round(p.y), 0, height - 1);
+        return normal(x, y);
+    }
+    //两个格子法线的夹角余弦，有一个距离为0时返回INFINITY
+    inline double cosAngle(int i1, int i2) {
+        if (mag.data[i1] <= 0 || mag.data[i2] <= 0) {
+            return INFINITY;
+        }
+        return nx.data[i1] * nx.data[i2] + ny.data[i1] * ny.data[i2];
+    }
+};
+
+//由向量距离场计算，元素需要有dir成员（指向最近障碍物）
+template <class vsdf_t>
+inline void build(gradientField& out, vsdf_t& vsdf) {
+    const int w = out.width;
+    const int h = out.height;
+#pragma omp parallel for
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            auto d = vsdf.at(i, j).dir;
+            double l = d.norm();
+            int index = j * w + i;
+            out.mag.data[index] = l;
+            if (l > 0) {
+                d /= l;
+                out.nx.data[index] = d.x;
+                out.ny.data[index] = d.y;
+            } else {
+                out.nx.data[index] = 0;
+                out.ny.data[index] = 0;
+            }
+        }
+    }
+}
+
+//只有sdf时（例如紧凑存储）用中心差分计算，法线为负梯度方向
+inline void build(gradientField& out, sdf::sdf& map) {
+    const int w = out.width;
+    const int h = out.height;
+#pragma omp parallel for
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            int xl = std::max(i - 1, 0), xr = std::min(i + 1, w - 1);
+            int yl = std::max(j - 1, 0), yr = std::min(j + 1, h - 1);
+            double gx = (xr > xl) ? (map.value(xr, j) - map.value(xl, j)) / (xr - xl) : 0;
+            double gy = (yr > yl) ? (map.value(i, yr) - map.value(i, yl)) / (yr - yl) : 0;
+            double l = sqrt(gx * gx + gy * gy);
+            int index = j * w + i;
+            out.mag.data[index] = map.value(i, j);
+            if (l > 0) {
+                out.nx.data[index] = -gx / l;
+                out.ny.data[index] = -gy / l;
+            } else {
+                out.nx.data[index] = 0;
+                out.ny.data[index] = 0;
+            }
+        }
+    }
+}
+
+}  // namespace sdpf::gradient
@@ -1,12 +1,20 @@
 #pragma once
+#include <fcntl.h>
+#include <omp.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <charconv>
 #include "navmesh.hpp"
 //加载/保存
 namespace sdpf::loader {
 
-template <typename T>
-inline void saveMap(field<T>& map, const std::string& path) {
-    auto len = sizeof(T) * map.width * map.height;
+template <typename T, typename layout_t>
+inline void saveMap(field<T, layout_t>& map, const std::string& path) {
+    auto len = sizeof(T) * map.size();  //按存储顺序整块读写
     auto fp = fopen(path.c_str(), "wb");
     if (fp) {
         fwrite(map.data, len, 1, fp);
@@ -14,9 +22,9 @@ inline void saveMap(field<T>& map, const std::string& path) {
     }
 }
 
-template <typename T>
-inline void loadMap(field<T>& map, const std::string& path) {
-    auto len = sizeof(T) * map.width * map.height;
+template <typename T, typename layout_t>
+inline void loadMap(field<T, layout_t>& map, const std::string& path) {
+    auto len = sizeof(T) * map.size();  //按存储顺序整块读写
     auto fp = fopen(path.c_str(), "rb");
     if (fp) {
         fread(map.data, len, 1, fp);
@@ -34,15 +42,29 @@ inline void save(navmesh::navmesh& mesh, const std::string& path) {
     auto path_pathNavMap = path + "/pathNavMap.chunk";
     auto path_idMap = path + "/idMap.chunk";
     mkdir(path.c_str(), S_IRWXU | S_IRWXG | S_IRWXO);
-    saveMap(mesh.vsdfMap, path_vsdfMap);
-    saveMap(mesh.sdfMap, path_sdfMap);
-    saveMap(mesh.pathDisMap, path_pathDisMap);
-    saveMap(mesh.pathNavMap, path_pathNavMap);
+    if (mesh.compact) {
+        //紧凑存储使用不同的文件名，避免旧版本按宽字段读取
+        saveMap(mesh.vsdfCompact, path_vsdfMap + ".compact");
+        saveMap(*mesh.sdfMap.packed, path_sdfMap + ".compact");
+        saveMap(mesh.pathDisCompact, path_pathDisMap + ".compact");
+        saveMap(mesh.pathNavCompact, path_pathNavMap + ".compact");
+    } else {
+        saveMap(mesh.vsdfMap, path_vsdfMap);
+        saveMap(mesh.sdfMap, path_sdfMap);
+        saveMap(mesh.pathDisMap, path_pathDisMap);
+        saveMap(mesh.pathNavMap, path_pathNavMap);
+    }
     saveMap(mesh.idMap, path_idMap);
     {
         auto fp = fopen(path_config.c_str(), "w");
         if (fp) {
             fprintf(fp, "%d %d %lf", mesh.width, mesh.height, mesh.minItemSize);
+            if (mesh.compact) {
+                fprintf(fp, " compact %.17g", mesh.sdfMap.packedStep);
+            }
+            if (mesh.eikonalFlow) {
+                fprintf(fp, " eikonal");
+            }
             fclose(fp);
         }
     }
@@ -85,24 +107,45 @@ inline navmesh::navmesh* load(const std::string& path) {
 
     int width, height;
     double minItemSize;
+    double sdfStep = 0;
+    bool compact = false;
+    bool eikonalFlow = false;
     auto fp_conf = fopen(path_config.c_str(), "r");
     bool haveFile = false;
     if (fp_conf) {
         if (fscanf(fp_conf, "%d %d %lf", &width, &height, &minItemSize) == 3) {
             haveFile = true;
+            //后面是可选的标记
+            char tag[32];
+            while (fscanf(fp_conf, " %31s", tag) == 1) {
+                if (strcmp(tag, "compact") == 0 && fscanf(fp_conf, " %lf", &sdfStep) == 1) {
+                    compact = true;
+                } else if (strcmp(tag, "eikonal") == 0) {
+                    eikonalFlow = true;
+                }
+            }
         }
         fclose(fp_conf);
     }
     if (!haveFile) {
         return nullptr;
     }
-    auto mesh = new navmesh::navmesh(width, height);
+    auto mesh = new navmesh::navmesh(width, height, compact);
     mesh->minItemSize = minItemSize;
+    mesh->eikonalFlow = eikonalFlow;
 
-    loadMap(mesh->vsdfMap, path_vsdfMap);
-    loadMap(mesh->sdfMap, path_sdfMap);
-    loadMap(mesh->pathDisMap, path_pathDisMap);
-    loadMap(mesh->pathNavMap, path_pathNavMap);
+    if (compact) {
+        mesh->sdfMap.packedStep = sdfStep;
+        loadMap(mesh->vsdfCompact, path_vsdfMap + ".compact");
+        loadMap(*mesh->sdfMap.packed, path_sdfMap + ".compact");
+        loadMap(mesh->pathDisCompact, path_pathDisMap + ".compact");
+        loadMap(mesh->pathNavCompact, path_pathNavMap + ".compact");
+    } else {
+        loadMap(mesh->vsdfMap, path_vsdfMap);
+        loadMap(mesh->sdfMap, path_sdfMap);
+        loadMap(mesh->pathDisMap, path_pathDisMap);
+        loadMap(mesh->pathNavMap, path_pathNavMap);
+    }
     loadMap(mesh->idMap, path_idMap);
     {
         auto fp = fopen(path_nodes.c_str(), "r");
@@ -149,6 +192,7 @@ inline navmesh::navmesh* load(const std::string& path) {
 
                             l->minWidth = minWidth;
                             l->maxPath = points;
+                            l->updateBox();
 
                             p1->ways.insert(l.get());
                             p2->ways.insert(l.get());
@@ -192,9 +236,218 @@ inline navmesh::navmesh* load(const std::string& path) {
             fclose(fp);
         }
     }
+    navmesh::buildAdjacency(*mesh);
     return mesh;
 }
 
+//只读内存映射文件
+struct mappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    mappedFile() = default;
+    mappedFile(const mappedFile&) = delete;
+    inline ~mappedFile() {
+        close();
+    }
+    inline bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+        auto addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        data = (const char*)addr;
+        size = st.st_size;
+        return true;
+    }
+    inline void close() {
+        if (data) {
+            munmap((void*)data, size);
+        }
+        data = nullptr;
+        size = 0;
+    }
+};
+
+//二进制点云格式：文件头后紧跟size*count字节的(x,y)对
+struct pointsHeader {
+    char magic[8];        //"SDPFPTS"
+    uint32_t version;     //版本，目前为1
+    uint32_t scalarSize;  //4为float，8为double
+    uint64_t count;       //点数
+};
+inline constexpr char pointsMagic[8] = "SDPFPTS";
+
+//内存映射的二进制点云，数据可以直接用于构建KD树
+struct pointsMap {
+    mappedFile file;
+    const pointsHeader* header = nullptr;
+    inline bool open(const std::string& path) {
+        header = nullptr;
+        if (!file.open(path) || file.size < sizeof(pointsHeader)) {
+            return false;
+        }
+        auto h = (const pointsHeader*)file.data;
+        if (memcmp(h->magic, pointsMagic, sizeof(pointsMagic)) != 0 ||
+            h->version != 1 ||
+            (h->scalarSize != 4 && h->scalarSize != 8) ||
+            h->count > (file.size - sizeof(pointsHeader)) / (2 * h->scalarSize)) {  //用除法，损坏的count不会溢出
+            file.close();
+            return false;
+        }
+        header = h;
+        return true;
+    }
+    inline size_t size() const {
+        return header ? header->count : 0;
+    }
+    inline const double* doubles() const {  //scalarSize为8时有效
+        return header && header->scalarSize == 8 ? (const double*)(header + 1) : nullptr;
+    }
+    inline const float* floats() const {  //scalarSize为4时有效
+        return header && header->scalarSize == 4 ? (const float*)(header + 1) : nullptr;
+    }
+    inline vec2 at(size_t i) const {
+        if (auto d = doubles()) {
+            return vec2(d[2 * i], d[2 * i + 1]);
+        }
+        auto f = floats();
+        return vec2(f[2 * i], f[2 * i + 1]);
+    }
+    inline KDTree* buildTree() const {
+        if (auto d = doubles()) {
+            return new KDTree(d, size());
+        }
+        if (auto f = floats()) {
+            return new KDTree(f, size());
+        }
+        return nullptr;
+    }
+};
+
+inline bool savePointsBinary(const std::vector<vec2>& points,
+                             const std::string& path,
+                             bool useFloat = false) {
+    auto fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    pointsHeader header;
+    memcpy(header.magic, pointsMagic, sizeof(pointsMagic));
+    header.version = 1;
+    header.scalarSize = useFloat ? 4 : 8;
+    header.count = points.size();
+    fwrite(&header, sizeof(header), 1, fp);
+    if (useFloat) {
+        std::vector<float> buf;
+        buf.reserve(points.size() * 2);
+        for (auto& it : points) {
+            buf.push_back(it.x);
+            buf.push_back(it.y);
+        }
+        fwrite(buf.data(), sizeof(float), buf.size(), fp);
+    } else {
+        static_assert(sizeof(vec2) == 2 * sizeof(double));
+        fwrite(points.data(), sizeof(vec2), points.size(), fp);
+    }
+    fclose(fp);
+    return true;
+}
+
+//解析一行中的两个数，与sscanf("%lf %lf")的行为一致
+inline bool parsePointLine(const char* begin, const char* end, vec2& out) {
+    auto parseNumber = [&](const char* p, double& value) -> const char* {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            ++p;
+        }
+        if (p < end && *p == '+') {  //from_chars不接受正号
+            ++p;
+            if (p < end && *p == '-') {
+                return nullptr;
+            }
+        }
+        auto res = std::from_chars(p, end, value);
+        return res.ec == std::errc() ? res.ptr : nullptr;
+    };
+    auto p = parseNumber(begin, out.x);
+    return p && parseNumber(p, out.y);
+}
+
+//多线程解析文本点云：按线程数把文件切成若干段，每段从行首开始
+inline void parsePoints(const char* data, size_t size, std::vector<vec2>& points) {
+    points.clear();
+    int threads = omp_get_max_threads();
+    std::vector<std::vector<vec2>> parts(threads);
+#pragma omp parallel num_threads(threads)
+    {
+        int thread_id = omp_get_thread_num();
+        int thread_count = omp_get_num_threads();
+        auto lineStart = [&](size_t pos) {  //pos所在行的下一行行首（pos为0时即文件开头）
+            if (pos == 0) {
+                return (size_t)0;
+            }
+            while (pos < size && data[pos - 1] != '\n') {
+                ++pos;
+            }
+            return pos;
+        };
+        size_t begin = lineStart(size * thread_id / thread_count);
+        size_t end = lineStart(size * (thread_id + 1) / thread_count);
+        auto& part = parts[thread_id];
+        part.reserve((end - begin) / 16);
+        while (begin < end) {
+            auto lineEnd = (const char*)memchr(data + begin, '\n', end - begin);
+            size_t next = lineEnd ? lineEnd - data + 1 : end;
+            vec2 p;
+            if (parsePointLine(data + begin, lineEnd ? lineEnd : data + end, p)) {
+                part.push_back(p);
+            }
+            begin = next;
+        }
+    }
+    //按段的顺序拼接
+    std::vector<size_t> offsets(threads + 1, 0);
+    for (int i = 0; i < threads; ++i) {
+        offsets[i + 1] = offsets[i] + parts[i].size();
+    }
+    points.resize(offsets[threads]);
+#pragma omp parallel for num_threads(threads)
+    for (int i = 0; i < threads; ++i) {
+        std::copy(parts[i].begin(), parts[i].end(), points.begin() + offsets[i]);
+    }
+}
+
+//读取点云，二进制格式和文本格式均可
+inline void loadPoints(std::vector<vec2>& points, const std::string& path) {
+    points.clear();
+    mappedFile file;
+    if (!file.open(path)) {
+        return;
+    }
+    if (file.size >= sizeof(pointsMagic) &&
+        memcmp(file.data, pointsMagic, sizeof(pointsMagic)) == 0) {
+        file.close();
+        pointsMap map;
+        if (map.open(path)) {
+            points.resize(map.size());
+            for (size_t i = 0; i < map.size(); ++i) {
+                points[i] = map.at(i);
+            }
+        }
+        return;
+    }
+    parsePoints(file.data, file.size, points);
+}
+
 inline void savePoints(const std::vector<point_t>& points, const std::string& path) {
     auto fp = fopen(path.c_str(), "w");
     if (fp) {
@@ -210,19 +463,12 @@ inline void savePoints(const std::vector<point_t>& points, const std::string& pa
 }
 
 inline void loadPoints(std::vector<point_t>& points, const std::string& path) {
+    std::vector<vec2> points_vec;
+    loadPoints(points_vec, path);
     points.clear();
-    auto fp = fopen(path.c_str(), "r");
-    if (fp) {
-        char buf[512];
-        while (!feof(fp)) {
-            double x, y;
-            bzero(buf, sizeof(buf));
-            fgets(buf, sizeof(buf), fp);
-            if (sscanf(buf, "%lf %lf", &x, &y) == 2) {
-                points.push_back({x, y});
-            }
-        }
-        fclose(fp);
+    points.reserve(points_vec.size());
+    for (auto& it : points_vec) {
+        points.push_back({it.x, it.y});
     }
 }
 
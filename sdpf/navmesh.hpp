@@ -1,13 +1,21 @@
 #pragma once
+#include <string.h>
+#include <array>
 #include <list>
 #include <map>
 #include <memory>
 #include <set>
+#include <stdexcept>
 #include <vec2.hpp>
 #include <vector>
 #include "astar_array.hpp"
+#include "ccl.hpp"
+#include "edt.hpp"
+#include "eikonal.hpp"
+#include "gradient.hpp"
 #include "pointcloud.hpp"
 #include "sdf.hpp"
+#include "thinning.hpp"
 //导航网络
 namespace sdpf::navmesh {
 
@@ -19,13 +27,27 @@ struct node {                   //节点
     int32_t flowFieldFlag = 0;  //流场寻路标识
     way* flowDir = nullptr;     //流场方向
     std::set<way*> ways{};      //相连
-    std::set<way*> tmpways{};   //临时路线
 };
 struct way {                            //连线
     node *p1 = nullptr, *p2 = nullptr;  //两个端点(id较小的排前面)
     std::vector<ivec2> maxPath{};       //值最大的路线（sdf极值线）
     double minWidth;                    //最小路宽，小于说明物体无法通过
     double length = 0;                  //路线长度
+    ivec2 boxBegin{0, 0};               //maxPath的包围盒（闭区间），修改maxPath后用updateBox重新计算
+    ivec2 boxEnd{-1, -1};
+    inline void updateBox() {
+        boxBegin.init(0, 0);
+        boxEnd.init(-1, -1);
+        if (maxPath.empty()) {
+            return;
+        }
+        boxBegin = maxPath[0];
+        boxEnd = maxPath[0];
+        for (auto& p : maxPath) {
+            boxBegin.init(std::min(boxBegin.x, p.x), std::min(boxBegin.y, p.y));
+            boxEnd.init(std::max(boxEnd.x, p.x), std::max(boxEnd.y, p.y));
+        }
+    }
 };
 
 struct pathNav {
@@ -59,18 +81,116 @@ struct pathDis {
     }
 };
 
+//紧凑编码，烘焙完成后由compress生成
+//最近障碍点，方向由格子坐标算出
+struct vectorDisPacked {
+    float x = 0, y = 0;
+};
+//流场：float代价，尾数最低4位存放相邻格子的方向编号（8为没有目标）
+struct pathNavPacked {
+    uint32_t bits = 0;
+};
+struct pathDisPacked {
+    int32_t firstNode = 0;
+    int32_t secondNode = 0;
+    int32_t pointIndex = 0;
+    float distance = 0;
+};
+
+//压缩稀疏行（CSR）存储的节点邻接表，由buildAdjacency生成，图搜索时顺序读取连续内存
+//id为i的节点的连线下标为[offsets[i - 1], offsets[i])，每条路线两个方向各存一次
+struct adjacency {
+    std::vector<int32_t> offsets{};    //节点数+1
+    std::vector<int32_t> neighbors{};  //另一端的节点id
+    std::vector<double> lengths{};     //路线长度
+    std::vector<double> minWidths{};   //最小路宽
+    std::vector<way*> ways{};          //对应的路线，用于还原路径
+    bool dirty = true;                 //ways或节点id变化后置为true，使用前重新生成
+};
+
+//一次查询的临时路线（起点、终点到所在路线两端），不修改节点
+struct queryEdges {
+    std::vector<way*> ways{};
+    inline void add(way* w) {
+        ways.push_back(w);
+    }
+    //callback(另一端, 路线)
+    template <class callback_c>
+    inline void forEach(const node* n, const callback_c& callback) const {
+        for (auto w : ways) {
+            if (w->p1 == n) {
+                callback(w->p2, w);
+            } else if (w->p2 == n) {
+                callback(w->p1, w);
+            }
+        }
+    }
+};
+
+//相邻8个格子的偏移，下标为方向编号
+inline constexpr int neighborOffset[8][2] = {
+    {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+inline constexpr uint32_t pathNavNone = 8;
+
+inline pathNavPacked encodePathNav(const pathNav& v, int x, int y) {
+    uint32_t code = pathNavNone;
+    if (v.target.x >= 0 || v.target.y >= 0) {
+        int dx = v.target.x - x;
+        int dy = v.target.y - y;
+        for (uint32_t i = 0; i < 8; ++i) {
+            if (neighborOffset[i][0] == dx && neighborOffset[i][1] == dy) {
+                code = i;
+                break;
+            }
+        }
+        if (code == pathNavNone) {
+            throw std::runtime_error("流场目标不是相邻格子");
+        }
+    }
+    float cost = v.cost;
+    uint32_t bits;
+    memcpy(&bits, &cost, sizeof(bits));
+    pathNavPacked res;
+    res.bits = (bits & ~0xFu) | code;
+    return res;
+}
+inline pathNav decodePathNav(const pathNavPacked& v, int x, int y) {
+    uint32_t code = v.bits & 0xFu;
+    uint32_t bits = v.bits & ~0xFu;
+    float cost;
+    memcpy(&cost, &bits, sizeof(cost));
+    if (code >= 8) {
+        return pathNav(ivec2(-1, -1), cost);
+    }
+    return pathNav(ivec2(x + neighborOffset[code][0], y + neighborOffset[code][1]), cost);
+}
+
 struct navmesh {
     std::vector<std::unique_ptr<node>> nodes{};                        //节点
     std::map<std::pair<int32_t, int32_t>, std::unique_ptr<way>> ways;  //相连(id较小的排前面)
+    adjacency graph;                                                   //节点邻接表，修改ways后置dirty，图搜索前由updateAdjacency重新生成
     sdf::sdf sdfMap;                                                   //sdf
     field<vectorDis> vsdfMap;                                          //向量距离场
     field<int32_t> idMap;                                              //地图上的节点id及道路信息
-    field<int32_t> searchMap;                                          //搜索标识
+    field<int32_t, layout::tiled<8>> searchMap;                        //搜索标识（分块存储，BFS访问更集中）
     field<pathDis> pathDisMap;                                         //路线离端点距离
     field<pathNav> pathNavMap;                                         //导航至路上的流场
     int32_t searchMap_id = 1;
     int width, height;
     double minItemSize = 2;  //最小物体的半径
+    bool eikonalFlow = false;  //上路流场由buildNavFlowFieldEikonal生成（局部重新烘焙按它选择重算方法）
+    //视为障碍物的地图边界，默认为整张地图
+    //分块烘焙时设为整个世界在块中的坐标，块自己的边缘不是障碍物
+    ivec2 boundBegin{0, 0};
+    ivec2 boundEnd{0, 0};
+
+    //紧凑存储（compact为true时上面的vsdfMap、pathDisMap、pathNavMap、searchMap已释放，
+    //sdfMap为16位定点数，需通过下面的get函数读取）
+    bool compact = false;
+    field<vectorDisPacked> vsdfCompact{0, 0};
+    field<pathDisPacked> pathDisCompact{0, 0};
+    field<pathNavPacked> pathNavCompact{0, 0};
+
     inline navmesh(int width, int height)
         : sdfMap(width, height),
           vsdfMap(width, height),
@@ -80,62 +200,192 @@ struct navmesh {
           pathNavMap(width, height) {
         this->width = width;
         this->height = height;
+        boundEnd.init(width, height);
         searchMap.setAll(0);
     }
+    //compact为true时直接创建紧凑存储，不分配宽字段（用于加载）
+    inline navmesh(int width, int height, bool compact)
+        : sdfMap(compact ? 0 : width, compact ? 0 : height),
+          vsdfMap(compact ? 0 : width, compact ? 0 : height),
+          idMap(width, height),
+          searchMap(compact ? 0 : width, compact ? 0 : height),
+          pathDisMap(compact ? 0 : width, compact ? 0 : height),
+          pathNavMap(compact ? 0 : width, compact ? 0 : height) {
+        this->width = width;
+        this->height = height;
+        boundEnd.init(width, height);
+        if (compact) {
+            sdfMap.resetPacked(width, height, 1.0);
+            vsdfCompact = field<vectorDisPacked>(width, height);
+            pathDisCompact = field<pathDisPacked>(width, height);
+            pathNavCompact = field<pathNavPacked>(width, height);
+            this->compact = true;
+        } else {
+            searchMap.setAll(0);
+        }
+    }
+
+    inline double getSdf(int x, int y) {
+        return sdfMap.value(x, y);
+    }
+    inline vectorDis getVsdf(int x, int y) {
+        if (compact) {
+            auto& v = vsdfCompact.at(x, y);
+            vectorDis res;
+            res.pos = vec2(v.x, v.y);
+            res.dir = res.pos - vec2(x, y);
+            return res;
+        }
+        return vsdfMap.at(x, y);
+    }
+    inline pathDis getPathDis(int x, int y) {
+        if (compact) {
+            auto& v = pathDisCompact.at(x, y);
+            return pathDis(v.firstNode, v.secondNode, v.distance, v.pointIndex);
+        }
+        return pathDisMap.at(x, y);
+    }
+    inline pathNav getPathNav(int x, int y) {
+        if (compact) {
+            return decodePathNav(pathNavCompact.at(x, y), x, y);
+        }
+        return pathNavMap.at(x, y);
+    }
 };
 
-inline void buildMeshFlowField(navmesh& mesh, node* target) {
+//烘焙完成后转换为紧凑存储，每格由约88字节降为34字节
+//sdf的精度按最大值在16位内选取，之后不能再调用build系列函数
+inline void compress(navmesh& mesh) {
+    if (mesh.compact) {
+        return;
+    }
+    const int w = mesh.width;
+    const int h = mesh.height;
+    double maxSdf = 0;
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            maxSdf = std::max(maxSdf, mesh.sdfMap.at(i, j));
+        }
+    }
+    mesh.vsdfCompact = field<vectorDisPacked>(w, h);
+    mesh.pathDisCompact = field<pathDisPacked>(w, h);
+    mesh.pathNavCompact = field<pathNavPacked>(w, h);
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            auto& v = mesh.vsdfMap.at(i, j);
+            mesh.vsdfCompact.at(i, j) = vectorDisPacked{(float)v.pos.x, (float)v.pos.y};
+            auto& d = mesh.pathDisMap.at(i, j);
+            mesh.pathDisCompact.at(i, j) =
+                pathDisPacked{d.firstNode, d.secondNode, d.pointIndex, (float)d.distance};
+            mesh.pathNavCompact.at(i, j) = encodePathNav(mesh.pathNavMap.at(i, j), i, j);
+        }
+    }
+    mesh.sdfMap.pack(std::max(maxSdf, 1.) / 65535.);
+    mesh.vsdfMap.release();
+    mesh.pathDisMap.release();
+    mesh.pathNavMap.release();
+    mesh.searchMap.release();
+    mesh.compact = true;
+}
+
+//由ways生成邻接表，邻居按路线的键排序
+inline void buildAdjacency(navmesh& mesh) {
+    auto& g = mesh.graph;
+    const int n = mesh.nodes.size();
+    const int e = mesh.ways.size() * 2;
+    g.offsets.assign(n + 1, 0);
+    for (auto& it : mesh.ways) {
+        ++g.offsets[it.first.first];
+        ++g.offsets[it.first.second];
+    }
+    for (int i = 0; i < n; ++i) {
+        g.offsets[i + 1] += g.offsets[i];
+    }
+    g.neighbors.resize(e);
+    g.lengths.resize(e);
+    g.minWidths.resize(e);
+    g.ways.resize(e);
+    g.dirty = false;
+    std::vector<int32_t> pos(g.offsets.begin(), g.offsets.end() - 1);
+    auto add = [&](int32_t from, int32_t to, way* w) {
+        int32_t i = pos[from - 1]++;
+        g.neighbors[i] = to;
+        g.lengths[i] = w->length;
+        g.minWidths[i] = w->minWidth;
+        g.ways[i] = w;
+    };
+    for (auto& it : mesh.ways) {
+        add(it.first.first, it.first.second, it.second.get());
+        add(it.first.second, it.first.first, it.second.get());
+    }
+}
+
+//callback(邻居id, 长度, 最小路宽, 路线)
+template <class callback_c>
+inline void forEachNeighbor(const navmesh& mesh, int32_t id, const callback_c& callback) {
+    auto& g = mesh.graph;
+    for (int32_t i = g.offsets[id - 1]; i < g.offsets[id]; ++i) {
+        callback(g.neighbors[i], g.lengths[i], g.minWidths[i], g.ways[i]);
+    }
+}
+
+//节点n的所有连线：id大于0时先读邻接表，再读本次查询的临时路线，邻接表必须是最新的
+//callback(另一端, 路线)
+template <class callback_c>
+inline void forEachEdge(navmesh& mesh, const node* n, const queryEdges& extra, const callback_c& callback) {
+    if (n->id > 0) {
+        forEachNeighbor(mesh, n->id, [&](int32_t id, double, double, way* w) {
+            callback(mesh.nodes[id - 1].get(), w);
+        });
+    }
+    extra.forEach(n, callback);
+}
+
+//邻接表过期时重新生成
+inline void updateAdjacency(navmesh& mesh) {
+    if (mesh.graph.dirty ||
+        mesh.graph.offsets.size() != mesh.nodes.size() + 1 ||
+        mesh.graph.neighbors.size() != mesh.ways.size() * 2) {
+        buildAdjacency(mesh);
+    }
+}
+
+//extra为本次查询的临时路线（连接id小于0的临时节点）
+inline void buildMeshFlowField(navmesh& mesh, node* target, const queryEdges& extra = queryEdges()) {
+    updateAdjacency(mesh);
     ++mesh.searchMap_id;
     target->flowValue = 0;
     target->flowDir = nullptr;
     std::queue<node*> que{};
 
     que.push(target);
-    std::set<int> connect;
     while (!que.empty()) {
-        const auto& node_search = que.front();
+        node* node_search = que.front();
         if (node_search->flowFieldFlag != mesh.searchMap_id) {
             node_search->flowFieldFlag = mesh.searchMap_id;
-            //printf("node_search->id=%d\n", node_search->id);
 
-            node* targetNavNode;
             double minLen = INFINITY;
+            double dirLen = 0;
             node_search->flowDir = nullptr;
-            for (auto& it : node_search->ways) {
-                if (it->p1 == node_search) {
-                    targetNavNode = it->p2;
-                } else {
-                    targetNavNode = it->p1;
-                }
+            auto visit = [&](node* targetNavNode, way* w, double length) {
                 if (targetNavNode->flowFieldFlag == mesh.searchMap_id) {
                     if (targetNavNode->flowValue < minLen) {
                         minLen = targetNavNode->flowValue;
-                        node_search->flowDir = it;
+                        dirLen = length;
+                        node_search->flowDir = w;
                     }
                 } else {
                     que.push(targetNavNode);
                 }
-            }
-            for (auto& it : node_search->tmpways) {
-                if (it->p1 == node_search) {
-                    targetNavNode = it->p2;
-                } else {
-                    targetNavNode = it->p1;
-                }
-                if (targetNavNode->flowFieldFlag == mesh.searchMap_id) {
-                    if (targetNavNode->flowValue < minLen) {
-                        minLen = targetNavNode->flowValue;
-                        node_search->flowDir = it;
-                    }
-                } else {
-                    que.push(targetNavNode);
-                }
-            }
+            };
+            forEachEdge(mesh, node_search, extra, [&](node* targetNavNode, way* w) {
+                visit(targetNavNode, w, w->length);
+            });
             if (node_search == target) {
                 node_search->flowValue = 0;
             } else {
                 if (node_search->flowDir) {
-                    node_search->flowValue = node_search->flowDir->length + minLen;
+                    node_search->flowValue = dirLen + minLen;
                 } else {
                     node_search->flowValue = INFINITY;
                 }
@@ -146,11 +396,12 @@ inline void buildMeshFlowField(navmesh& mesh, node* target) {
     }
 }
 
-inline vectorDis vsdf_box(const vec2& pos, int width, int height) {
+//到矩形边界[begin, end]的向量距离
+inline vectorDis vsdf_box(const vec2& pos, const ivec2& begin, const ivec2& end) {
     vectorDis res;
-    double lens[] = {pos.y, height - pos.y, pos.x, width - pos.x};
-    vec2 poss[] = {vec2(pos.x, 0), vec2(pos.x, height),
-                   vec2(0, pos.y), vec2(width, pos.y)};
+    double lens[] = {pos.y - begin.y, end.y - pos.y, pos.x - begin.x, end.x - pos.x};
+    vec2 poss[] = {vec2(pos.x, begin.y), vec2(pos.x, end.y),
+                   vec2(begin.x, pos.y), vec2(end.x, pos.y)};
     double minLen = INFINITY;
     for (int i = 0; i < 4; ++i) {
         if (lens[i] < minLen) {
@@ -161,26 +412,217 @@ inline vectorDis vsdf_box(const vec2& pos, int width, int height) {
     }
     return res;
 }
+inline vectorDis vsdf_box(const vec2& pos, int width, int height) {
+    return vsdf_box(pos, ivec2(0, 0), ivec2(width, height));
+}
 
-inline void buildSdfMap(navmesh& mesh, KDTree& tree) {
-#pragma omp parallel for
-    for (int i = 0; i < mesh.width; ++i) {
+inline void buildSdfMap(navmesh& mesh, const KDTree& tree) {
+    mesh.sdfMap.minPyramid.reset();  //整张sdf重建，旧的金字塔作废
+#pragma omp parallel
+    {
+        //按行批量查询，相邻像素的最近点几乎相同
+        std::vector<vec2> row_pos(mesh.width);
+        std::vector<KDPoint> row_nearest(mesh.width);
+        std::vector<double> row_dis2(mesh.width);
+#pragma omp for
         for (int j = 0; j < mesh.height; ++j) {
-            //点的位置
-            vectorDis sdfp;
-            pointcloud::getPointDis(tree, vec2(i, j), sdfp.dir, sdfp.pos);
+            for (int i = 0; i < mesh.width; ++i) {
+                row_pos[i] = vec2(i, j);
+            }
+            bool found = tree.nearest_batch(row_pos.data(), mesh.width,
+                                            row_nearest.data(), row_dis2.data());
+            for (int i = 0; i < mesh.width; ++i) {
+                //点的位置
+                vectorDis sdfp;
+                if (found) {
+                    sdfp.pos = row_nearest[i].pos;
+                    sdfp.dir = sdfp.pos - row_pos[i];
+                }
+                //边缘
+                auto boxsdf = vsdf_box(row_pos[i], mesh.boundBegin, mesh.boundEnd);
+                //选距离最短的
+                if (sdfp.dir.norm() < boxsdf.dir.norm()) {
+                    mesh.vsdfMap.at(i, j) = sdfp;
+                    mesh.sdfMap.at(i, j) = sdfp.dir.norm();
+                } else {
+                    mesh.vsdfMap.at(i, j) = boxsdf;
+                    mesh.sdfMap.at(i, j) = boxsdf.dir.norm();
+                }
+            }
+        }
+    }
+}
+
+//用欧氏距离变换构建sdf，耗时与点数无关
+//点先栅格化到最近的格子，最近点按格子中心求出，距离按点的真实坐标计算
+//点在整数坐标上时与buildSdfMap结果一致，否则距离误差不超过一个格子的对角线
+//地图外的点总比地图边缘远，可以直接忽略（边界比地图大时不成立，应使用buildSdfMap）
+inline void buildSdfMapEDT(navmesh& mesh, const std::vector<vec2>& points) {
+    mesh.sdfMap.minPyramid.reset();  //整张sdf重建，旧的金字塔作废
+    field<int32_t> sites(mesh.width, mesh.height);
+    field<int32_t> nearest(mesh.width, mesh.height);
+    sites.setAll(-1);
+    int points_len = points.size();
+    for (int index = 0; index < points_len; ++index) {
+        auto& p = points[index];
+        if (p.x < 0 || p.y < 0 || p.x > mesh.width || p.y > mesh.height) {
+            continue;
+        }
+        int x = std::min((int)round(p.x), mesh.width - 1);
+        int y = std::min((int)round(p.y), mesh.height - 1);
+        auto& site = sites.at(x, y);
+        //同一格子保留离中心最近的点
+        if (site < 0 || p.length2(vec2(x, y)) < points[site].length2(vec2(x, y))) {
+            site = index;
+        }
+    }
+
+    edt::transform(sites, nearest);
+
+#pragma omp parallel for
+    for (int j = 0; j < mesh.height; ++j) {
+        for (int i = 0; i < mesh.width; ++i) {
+            vec2 pos(i, j);
+            int index = nearest.at(i, j);
             //边缘
-            auto boxsdf = vsdf_box(vec2(i, j), mesh.width, mesh.height);
-            //选距离最短的
-            if (sdfp.dir.norm() < boxsdf.dir.norm()) {
-                mesh.vsdfMap.at(i, j) = sdfp;
-                mesh.sdfMap.at(i, j) = sdfp.dir.norm();
+            auto boxsdf = vsdf_box(pos, mesh.boundBegin, mesh.boundEnd);
+            if (index >= 0) {
+                //点的位置
+                vectorDis sdfp;
+                sdfp.pos = points[index];
+                sdfp.dir = sdfp.pos - pos;
+                //选距离最短的
+                if (sdfp.dir.norm() < boxsdf.dir.norm()) {
+                    mesh.vsdfMap.at(i, j) = sdfp;
+                    mesh.sdfMap.at(i, j) = sdfp.dir.norm();
+                    continue;
+                }
+            }
+            mesh.vsdfMap.at(i, j) = boxsdf;
+            mesh.sdfMap.at(i, j) = boxsdf.dir.norm();
+        }
+    }
+}
+
+inline void buildSdfMapEDT(navmesh& mesh, const std::vector<point_t>& points) {
+    std::vector<vec2> points_vec;
+    points_vec.reserve(points.size());
+    for (auto& it : points) {
+        points_vec.push_back(vec2(it.at(0), it.at(1)));
+    }
+    buildSdfMapEDT(mesh, points_vec);
+}
+
+//重新计算单个像素的sdf
+inline void updateSdfPixel(navmesh& mesh, const KDTree& tree, int i, int j) {
+    vec2 pos(i, j);
+    vectorDis sdfp;
+    pointcloud::getPointDis(tree, pos, sdfp.dir, sdfp.pos);
+    auto boxsdf = vsdf_box(pos, mesh.boundBegin, mesh.boundEnd);
+    if (sdfp.dir.norm() < boxsdf.dir.norm()) {
+        mesh.vsdfMap.at(i, j) = sdfp;
+        mesh.sdfMap.at(i, j) = sdfp.dir.norm();
+    } else {
+        mesh.vsdfMap.at(i, j) = boxsdf;
+        mesh.sdfMap.at(i, j) = boxsdf.dir.norm();
+    }
+}
+
+//以center为中心逐圈向外扫描，callback返回该像素附近是否还可能受影响，整圈都不受影响时停止
+template <class callback_c>
+inline void scanRings(navmesh& mesh, const ivec2& center, const callback_c& callback) {
+    for (int k = 0;; ++k) {
+        int x0 = center.x - k, x1 = center.x + k;
+        int y0 = center.y - k, y1 = center.y + k;
+        bool goOn = false;
+        for (int y = std::max(y0, 0); y <= std::min(y1, mesh.height - 1); ++y) {
+            if (y == y0 || y == y1) {
+                for (int x = std::max(x0, 0); x <= std::min(x1, mesh.width - 1); ++x) {
+                    goOn |= callback(x, y);
+                }
             } else {
-                mesh.vsdfMap.at(i, j) = boxsdf;
-                mesh.sdfMap.at(i, j) = boxsdf.dir.norm();
+                if (x0 >= 0) {
+                    goOn |= callback(x0, y);
+                }
+                if (x1 < mesh.width && x1 != x0) {
+                    goOn |= callback(x1, y);
+                }
             }
         }
+        if (!goOn || (x0 <= 0 && y0 <= 0 && x1 >= mesh.width - 1 && y1 >= mesh.height - 1)) {
+            break;
+        }
+    }
+}
+
+//障碍点变化后局部更新sdf，只重算最近点可能改变的像素
+//tree必须已经插入added中的点并删除removed中的点
+//[dirtyBegin, dirtyEnd]为被修改的矩形（闭区间），没有像素变化时返回false
+inline bool updateSdfMap(navmesh& mesh,
+                         const KDTree& tree,
+                         const std::vector<vec2>& added,
+                         const std::vector<vec2>& removed,
+                         ivec2& dirtyBegin,
+                         ivec2& dirtyEnd) {
+    //sdf满足1-Lipschitz，相邻一圈的像素距离差不超过该值，用于判断能否停止扫描
+    const double slack = 1 + M_SQRT2;
+    bool dirty = false;
+    dirtyBegin = ivec2(mesh.width, mesh.height);
+    dirtyEnd = ivec2(-1, -1);
+    auto markDirty = [&](int x, int y) {
+        dirty = true;
+        dirtyBegin.init(std::min(dirtyBegin.x, x), std::min(dirtyBegin.y, y));
+        dirtyEnd.init(std::max(dirtyEnd.x, x), std::max(dirtyEnd.y, y));
+    };
+    auto inMap = [&](const vec2& p) {
+        //地图外的点总比地图边缘远，不会成为最近点
+        return p.x >= 0 && p.y >= 0 && p.x <= mesh.width && p.y <= mesh.height;
+    };
+    auto centerOf = [&](const vec2& p) {
+        return ivec2(std::min((int)round(p.x), mesh.width - 1),
+                     std::min((int)round(p.y), mesh.height - 1));
+    };
+    //删除的点：以它为最近点的像素重新查询
+    for (auto& q : removed) {
+        if (!inMap(q)) {
+            continue;
+        }
+        scanRings(mesh, centerOf(q), [&](int x, int y) {
+            auto& v = mesh.vsdfMap.at(x, y);
+            double dis = q.length(vec2(x, y));
+            if (v.pos == q) {
+                updateSdfPixel(mesh, tree, x, y);
+                markDirty(x, y);
+                return true;
+            }
+            return dis <= mesh.sdfMap.at(x, y) + slack;
+        });
+    }
+    //新增的点：比原最近点更近的像素直接指向它
+    for (auto& q : added) {
+        if (!inMap(q)) {
+            continue;
+        }
+        scanRings(mesh, centerOf(q), [&](int x, int y) {
+            auto& sdf = mesh.sdfMap.at(x, y);
+            vec2 pos(x, y);
+            double dis = q.length(pos);
+            if (dis < sdf) {
+                auto& v = mesh.vsdfMap.at(x, y);
+                v.pos = q;
+                v.dir = q - pos;
+                sdf = v.dir.norm();
+                markDirty(x, y);
+                return true;
+            }
+            return dis <= sdf + slack;
+        });
+    }
+    if (dirty) {
+        //金字塔中的下界不能比sdf大，否则segmentClear会穿过新的障碍物
+        mesh.sdfMap.updatePyramid(dirtyBegin.x, dirtyBegin.y, dirtyEnd.x, dirtyEnd.y);
     }
+    return dirty;
 }
 
 inline double getCosPointDirDeg(navmesh& mesh, const ivec2& p1, const ivec2& p2) {
@@ -225,23 +667,190 @@ inline bool isRidge(navmesh& mesh, const ivec2& p, double isRidgeMinCosD = 0.866
             getCosPointDirDeg(mesh, p + ivec2(1, 0), p + ivec2(1, 1)) < isRidgeMinCosD);
 }
 
-inline void buildIdMap(navmesh& mesh, std::vector<ivec2>& startPoints, double minPathWith) {
-    omp_lock_t locker;
-    omp_init_lock(&locker);
+//使用预先计算的法线场，结果与上面相同
+inline bool isRidge(navmesh& mesh,
+                    gradient::gradientField& grad,
+                    const ivec2& p,
+                    double isRidgeMinCosD = 0.866025403784438) {
+    if (p.x <= 0 || p.y <= 0 || p.x >= mesh.width - 1 || p.y >= mesh.height - 1) {
+        //地图边缘不能检测
+        return false;
+    }
+    const int w = mesh.width;
+    const int center = p.y * w + p.x;
+    if (grad.mag.data[center] < mesh.minItemSize) {
+        return false;
+    }
+    auto test = [&](int dx1, int dy1, int dx2, int dy2) {
+        int i1 = center + dy1 * w + dx1;
+        int i2 = center + dy2 * w + dx2;
+        if (!(grad.cosAngle(i1, i2) < isRidgeMinCosD)) {
+            return false;
+        }
+        //夹角够大时再排除最近点相同的情况
+        auto delta = mesh.vsdfMap.at(p.x + dx1, p.y + dy1).pos - mesh.vsdfMap.at(p.x + dx2, p.y + dy2).pos;
+        return !(fabs(delta.x) + fabs(delta.y) < 0.0001);
+    };
+    return (test(1, 0, 0, 0) ||
+            test(1, 1, 0, 0) ||
+            test(0, 1, 0, 0) ||
+            test(1, 0, 1, 1));
+}
+//山脊掩码：按行并行，行内用SIMD计算四组法线夹角得到候选，
+//再对少量候选做精确检查（排除最近点相同的情况），结果与isRidge相同
+inline void buildRidgeMask(navmesh& mesh,
+                           gradient::gradientField& grad,
+                           double minPathWith,
+                           field<uint8_t>& mask,
+                           double isRidgeMinCosD = 0.866025403784438) {
+    const int w = mesh.width;
+    const int h = mesh.height;
+    const double minItemSize = mesh.minItemSize;
+    const double* sdf = mesh.sdfMap.field<double>::data;
+    const double* nx = grad.nx.data;
+    const double* ny = grad.ny.data;
+    const double* mag = grad.mag.data;
 #pragma omp parallel for
-    for (int i = 0; i < mesh.sdfMap.width; ++i) {
-        for (int j = 0; j < mesh.sdfMap.height; ++j) {
-            if (mesh.sdfMap.at(i, j) > minPathWith && isRidge(mesh, ivec2(i, j))) {
-                omp_set_lock(&locker);
-                startPoints.push_back(ivec2(i, j));
-                omp_unset_lock(&locker);
-                mesh.idMap.at(i, j) = -1;
-            } else {
-                mesh.idMap.at(i, j) = 0;
+    for (int j = 0; j < h; ++j) {
+        uint8_t* out = mask.data + j * w;
+        if (j == 0 || j == h - 1) {
+            //地图边缘不能检测
+            for (int i = 0; i < w; ++i) {
+                out[i] = 0;
+            }
+            continue;
+        }
+        out[0] = 0;
+        out[w - 1] = 0;
+        const double* nx0 = nx + j * w;
+        const double* ny0 = ny + j * w;
+        const double* m0 = mag + j * w;
+        const double* nx1 = nx0 + w;
+        const double* ny1 = ny0 + w;
+        const double* m1 = m0 + w;
+        const double* s0 = sdf + j * w;
+#pragma omp simd
+        for (int i = 1; i < w - 1; ++i) {
+            //四组：(右,中) (右下,中) (下,中) (右,右下)
+            double c1 = nx0[i + 1] * nx0[i] + ny0[i + 1] * ny0[i];
+            double c2 = nx1[i + 1] * nx0[i] + ny1[i + 1] * ny0[i];
+            double c3 = nx1[i] * nx0[i] + ny1[i] * ny0[i];
+            double c4 = nx0[i + 1] * nx1[i + 1] + ny0[i + 1] * ny1[i + 1];
+            bool v00 = m0[i] > 0;
+            bool v10 = m0[i + 1] > 0;
+            bool v01 = m1[i] > 0;
+            bool v11 = m1[i + 1] > 0;
+            bool cand = (v10 & v00 & (c1 < isRidgeMinCosD)) |
+                        (v11 & v00 & (c2 < isRidgeMinCosD)) |
+                        (v01 & v00 & (c3 < isRidgeMinCosD)) |
+                        (v10 & v11 & (c4 < isRidgeMinCosD));
+            out[i] = cand & (s0[i] > minPathWith) & !(s0[i] < minItemSize);
+        }
+        for (int i = 1; i < w - 1; ++i) {
+            if (out[i] && !isRidge(mesh, grad, ivec2(i, j), isRidgeMinCosD)) {
+                out[i] = 0;
             }
         }
     }
-    omp_destroy_lock(&locker);
+}
+
+//mask非0的格子在idMap中标为-1并追加到startPoints，其余为0
+inline void applyIdMask(navmesh& mesh, field<uint8_t>& mask, std::vector<ivec2>& startPoints) {
+    const int w = mesh.width;
+    const int h = mesh.height;
+#pragma omp parallel for
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            mesh.idMap.at(i, j) = mask.data[j * w + i] ? -1 : 0;
+        }
+    }
+    //输出按列优先（与逐列扫描相同），但mask是按行存储的：
+    //把列分成宽为tile的条带，条带内按行读取，先统计每列的个数，
+    //前缀和得到每列的写入位置后再按行填充，同一列的格子仍按行号递增写入，不需要加锁
+    const int tile = 64;
+    const int tiles = (w + tile - 1) / tile;
+    size_t base = startPoints.size();
+    std::vector<size_t> colOffsets(w + 1, 0);
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < tiles; ++t) {
+        int col_begin = t * tile;
+        int col_end = std::min(col_begin + tile, w);
+        size_t* count = colOffsets.data() + 1;
+        for (int j = 0; j < h; ++j) {
+            const uint8_t* row = mask.data + j * w;
+            for (int i = col_begin; i < col_end; ++i) {
+                count[i] += row[i] != 0;
+            }
+        }
+    }
+    for (int i = 0; i < w; ++i) {
+        colOffsets[i + 1] += colOffsets[i];
+    }
+    startPoints.resize(base + colOffsets[w]);
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < tiles; ++t) {
+        int col_begin = t * tile;
+        int col_end = std::min(col_begin + tile, w);
+        size_t* pos = colOffsets.data();  //各列的写入位置，条带之间互不重叠
+        for (int j = 0; j < h; ++j) {
+            const uint8_t* row = mask.data + j * w;
+            for (int i = col_begin; i < col_end; ++i) {
+                if (row[i]) {
+                    startPoints[base + pos[i]++] = ivec2(i, j);
+                }
+            }
+        }
+    }
+}
+
+inline void buildIdMap(navmesh& mesh, std::vector<ivec2>& startPoints, double minPathWith) {
+    field<uint8_t> mask(mesh.width, mesh.height);
+    {
+        gradient::gradientField grad(mesh.width, mesh.height);
+        gradient::build(grad, mesh.vsdfMap);
+        buildRidgeMask(mesh, grad, minPathWith, mask);
+    }
+    applyIdMask(mesh, mask, startPoints);
+}
+
+//用细化代替山脊检测：把路宽足够的区域按sdf从小到大细化成一个像素宽的骨架
+//骨架与区域的连通性相同，分支的端点停在山脊上，格子比山脊少，后面的节点检测和连线更快
+inline void buildIdMapThinning(navmesh& mesh, std::vector<ivec2>& startPoints, double minPathWith) {
+    const int w = mesh.width;
+    const int h = mesh.height;
+    field<uint8_t> mask(w, h);
+    field<uint8_t> ridge(w, h);
+    {
+        gradient::gradientField grad(w, h);
+        gradient::build(grad, mesh.vsdfMap);
+        buildRidgeMask(mesh, grad, minPathWith, ridge);
+    }
+    const double minItemSize = mesh.minItemSize;
+    const double* sdf = mesh.sdfMap.field<double>::data;
+#pragma omp parallel for
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            double s = sdf[j * w + i];
+            //地图边缘与山脊检测一样排除
+            bool edge = i == 0 || j == 0 || i == w - 1 || j == h - 1;
+            mask.data[j * w + i] = !edge && s > minPathWith && !(s < minItemSize);
+        }
+    }
+    thinning::thin(mask, sdf, ridge);
+    applyIdMask(mesh, mask, startPoints);
+}
+
+//细化后的骨架只有一个像素宽，线上的格子恰好有两个相邻格子，三个以上即为分叉
+inline bool isJunction(navmesh& mesh, const ivec2& pos) {
+    int count = 0;
+    for (int k = 0; k < 8; ++k) {
+        int x = pos.x + neighborOffset[k][0];
+        int y = pos.y + neighborOffset[k][1];
+        if (x >= 0 && y >= 0 && x < mesh.width && y < mesh.height && mesh.idMap.at(x, y) == -2) {
+            ++count;
+        }
+    }
+    return count >= 3;
 }
 
 inline bool isNode(navmesh& mesh, const ivec2& pos, int area = 2) {
@@ -360,27 +969,25 @@ inline bool isNode(navmesh& mesh, const ivec2& pos, int area = 2) {
     return count >= 3;
 }
 
+//按连通域分组，输出的顺序与逐个洪水填充相同：
+//连通域按最小的点排序，每个连通域内是从最小的点开始的广搜顺序
 inline void getIsland(navmesh& mesh,
-                      std::vector<ivec2>& points,
+                      field<uint8_t>& mask,
                       std::vector<std::vector<ivec2>>& islands) {
     islands.clear();
-    std::set<ivec2> points_nosearch;
-    for (auto& p : points) {
-        points_nosearch.insert(p);
-    }
-    while (!points_nosearch.empty()) {
-        auto sit = points_nosearch.begin();
-        ivec2 begin = *sit;
-        points_nosearch.erase(sit);
-
-        std::vector<ivec2> points_buffer;
-
-        std::queue<ivec2> que;
-        que.push(begin);
+    field<int32_t> labels(mesh.width, mesh.height);
+    std::vector<ivec2> seeds;
+    int count = ccl::label(mask, labels, seeds);
+    islands.resize(count);
+    //广搜时清掉已访问的标记，labels本身即为是否属于该连通域
+    std::queue<ivec2> que;
+    for (int id = 1; id <= count; ++id) {
+        auto& points_buffer = islands[id - 1];
+        que.push(seeds[id - 1]);
+        labels.at(seeds[id - 1].x, seeds[id - 1].y) = 0;
         while (!que.empty()) {
             const auto& pos = que.front();
             points_buffer.push_back(pos);
-
             for (int i = -1; i <= 1; ++i) {
                 for (int j = -1; j <= 1; ++j) {
                     if (!(i == 0 && j == 0)) {
@@ -388,31 +995,94 @@ inline void getIsland(navmesh& mesh,
                         int y = j + pos.y;
                         if (x >= 0 && y >= 0 &&
                             x < mesh.width && y < mesh.height) {
-                            auto it = points_nosearch.find(ivec2(x, y));
-                            if (it != points_nosearch.end()) {
-                                points_nosearch.erase(it);
+                            auto& l = labels.at(x, y);
+                            if (l == id) {
+                                l = 0;
                                 que.push(ivec2(x, y));
                             }
                         }
                     }
                 }
             }
-
             que.pop();
         }
+    }
+}
+inline void getIsland(navmesh& mesh,
+                      std::vector<ivec2>& points,
+                      std::vector<std::vector<ivec2>>& islands) {
+    field<uint8_t> mask(mesh.width, mesh.height);
+    mask.setAll(0);
+    for (auto& p : points) {
+        mask.at(p.x, p.y) = 1;
+    }
+    getIsland(mesh, mask, islands);
+}
+//两个节点间的一条路线，先并行搜索，再按顺序写入mesh
+struct wayCandidate {
+    int begin_id = 0;
+    ivec2 begin{};
+    int target_id = 0;
+    ivec2 target{};
+    std::vector<std::tuple<ivec2, double, double>> path{};  //位置，宽度，距离
+    double lenSum = 0.;
+    double minWidth = INFINITY;
+    ivec2 areaBegin{0, 0};  //搜索范围的包围盒（闭区间），为空时由findPath用searchArea求出
+    ivec2 areaEnd{-1, -1};
+};
 
-        islands.push_back(std::move(points_buffer));
+//从begin出发沿骨架（-2和两端节点的块）能走到的范围的包围盒
+//使用searchMap，不能并行调用
+inline void searchArea(navmesh& mesh, wayCandidate& way_c) {
+    const int begin_id = way_c.begin_id;
+    const int target_id = way_c.target_id;
+    ivec2& lo = way_c.areaBegin;
+    ivec2& hi = way_c.areaEnd;
+    lo = way_c.begin;
+    hi = way_c.begin;
+    auto grow = [&](const ivec2& p) {
+        lo.init(std::min(lo.x, p.x), std::min(lo.y, p.y));
+        hi.init(std::max(hi.x, p.x), std::max(hi.y, p.y));
+    };
+    grow(way_c.target);
+    ++mesh.searchMap_id;
+    std::queue<ivec2> que;
+    que.push(way_c.begin);
+    mesh.searchMap.at(way_c.begin.x, way_c.begin.y) = mesh.searchMap_id;
+    while (!que.empty()) {
+        auto pos = que.front();
+        que.pop();
+        grow(pos);
+        for (int k = 0; k < 8; ++k) {
+            int x = pos.x + neighborOffset[k][0];
+            int y = pos.y + neighborOffset[k][1];
+            if (x >= 0 && y >= 0 && x < mesh.width && y < mesh.height &&
+                mesh.searchMap.at(x, y) != mesh.searchMap_id) {
+                auto id = mesh.idMap.at(x, y);
+                if (id == -2 || id == begin_id || id == target_id) {
+                    mesh.searchMap.at(x, y) = mesh.searchMap_id;
+                    que.push(ivec2(x, y));
+                }
+            }
+        }
     }
 }
 
-inline void buildPath(navmesh& mesh,
-                      int begin_id,
-                      const ivec2& begin,
-                      int target_id,
-                      const ivec2& target,
-                      int it_count = 1024) {
-    astar_array::context atx;
-    astar_array::start(
+//沿骨架搜索路线，atx的窗口设为way_c的搜索范围
+//已给出搜索范围时只读mesh，每个线程使用自己的atx时可以并行调用
+//it_count小于0时不限制搜索的格子数（搜索只在骨架上进行）
+inline bool findPath(navmesh& mesh, wayCandidate& way_c, astar_array::grid& atx, int it_count = -1) {
+    const int begin_id = way_c.begin_id;
+    const int target_id = way_c.target_id;
+    const ivec2& begin = way_c.begin;
+    const ivec2& target = way_c.target;
+    auto& path = way_c.path;
+    path.clear();
+    if (way_c.areaEnd.x < way_c.areaBegin.x || way_c.areaEnd.y < way_c.areaBegin.y) {
+        searchArea(mesh, way_c);
+    }
+    atx.setWindow(way_c.areaBegin, way_c.areaEnd);
+    astar_array::search(
         atx, begin, target, [&](const ivec2& pos, auto callback) {
             for (int i = -1; i <= 1; ++i) {
                 for (int j = -1; j <= 1; ++j) {
@@ -431,149 +1101,234 @@ inline void buildPath(navmesh& mesh,
             }
         },
         it_count);
-    std::vector<std::tuple<ivec2, double, double>> path{};  //位置，宽度，距离
     astar_array::buildRoad(atx, [&](const ivec2& pos) {
         path.push_back(std::make_tuple(pos, 0., 0.));
     });
 
-    if (path.size() > 1) {
-        //printf("path:");
-        path.pop_back();
-        std::reverse(path.begin(), path.end());
-        ivec2 last = begin;
-        double lenSum = 0.;
-        double minWidth = INFINITY;
-        for (auto& point : path) {
-            auto& pos = std::get<0>(point);
-            auto& width = std::get<1>(point);
-            auto& len = std::get<2>(point);
-            auto deltaLen = pos.length(last);
-            lenSum += deltaLen;
-            len = lenSum;
-            width = mesh.sdfMap.at(pos.x, pos.y);
-            if (width < minWidth) {
-                minWidth = width;
-            }
-            last = pos;
-            //printf("(%d,%d,%lf,%lf) ", pos.x, pos.y, len, width);
-        }
-        lenSum += target.length(last);
-        //printf("\n");
-
-        //计算到两端距离
-        int maxPath_index = 0;
-        for (auto& point : path) {
-            auto& pos = std::get<0>(point);
-            double delta_p1 = std::get<2>(point);
-            double delta_p2 = lenSum - delta_p1;
-            if (delta_p1 > delta_p2) {
-                mesh.pathDisMap.at(pos.x, pos.y) =
-                    pathDis(begin_id, target_id, delta_p2, maxPath_index);
-            } else {
-                mesh.pathDisMap.at(pos.x, pos.y) =
-                    pathDis(target_id, begin_id, delta_p1, maxPath_index);
-            }
-            ++maxPath_index;
+    if (path.size() <= 1) {
+        return false;
+    }
+    //printf("path:");
+    path.pop_back();
+    std::reverse(path.begin(), path.end());
+    ivec2 last = begin;
+    double lenSum = 0.;
+    double minWidth = INFINITY;
+    for (auto& point : path) {
+        auto& pos = std::get<0>(point);
+        auto& width = std::get<1>(point);
+        auto& len = std::get<2>(point);
+        auto deltaLen = pos.length(last);
+        lenSum += deltaLen;
+        len = lenSum;
+        width = mesh.sdfMap.at(pos.x, pos.y);
+        if (width < minWidth) {
+            minWidth = width;
         }
+        last = pos;
+        //printf("(%d,%d,%lf,%lf) ", pos.x, pos.y, len, width);
+    }
+    lenSum += target.length(last);
+    //printf("\n");
+    way_c.lenSum = lenSum;
+    way_c.minWidth = minWidth;
+    return true;
+}
 
-        //创建路线
-        auto way_key = std::make_pair(begin_id, target_id);
-        if (mesh.ways.find(way_key) == mesh.ways.end()) {
-            std::unique_ptr<way> l(new way);
-            l->p1 = mesh.nodes.at(begin_id - 1).get();
-            l->p2 = mesh.nodes.at(target_id - 1).get();
+//写入路线离端点的距离并创建路线
+inline void commitPath(navmesh& mesh, wayCandidate& way_c) {
+    const int begin_id = way_c.begin_id;
+    const int target_id = way_c.target_id;
+    auto& path = way_c.path;
+    const double lenSum = way_c.lenSum;
 
-            l->length = lenSum;
+    //计算到两端距离
+    int maxPath_index = 0;
+    for (auto& point : path) {
+        auto& pos = std::get<0>(point);
+        double delta_p1 = std::get<2>(point);
+        double delta_p2 = lenSum - delta_p1;
+        if (delta_p1 > delta_p2) {
+            mesh.pathDisMap.at(pos.x, pos.y) =
+                pathDis(begin_id, target_id, delta_p2, maxPath_index);
+        } else {
+            mesh.pathDisMap.at(pos.x, pos.y) =
+                pathDis(target_id, begin_id, delta_p1, maxPath_index);
+        }
+        ++maxPath_index;
+    }
 
-            l->minWidth = minWidth;
-            for (auto& point : path) {
-                auto& pos = std::get<0>(point);
-                l->maxPath.push_back(pos);
-            }
+    //创建路线
+    auto way_key = std::make_pair(begin_id, target_id);
+    if (mesh.ways.find(way_key) == mesh.ways.end()) {
+        std::unique_ptr<way> l(new way);
+        l->p1 = mesh.nodes.at(begin_id - 1).get();
+        l->p2 = mesh.nodes.at(target_id - 1).get();
 
-            mesh.nodes.at(begin_id - 1)->ways.insert(l.get());
-            mesh.nodes.at(target_id - 1)->ways.insert(l.get());
+        l->length = lenSum;
 
-            mesh.ways[way_key] = std::move(l);
+        l->minWidth = way_c.minWidth;
+        for (auto& point : path) {
+            auto& pos = std::get<0>(point);
+            l->maxPath.push_back(pos);
         }
+        l->updateBox();
+
+        mesh.nodes.at(begin_id - 1)->ways.insert(l.get());
+        mesh.nodes.at(target_id - 1)->ways.insert(l.get());
+
+        mesh.ways[way_key] = std::move(l);
+        mesh.graph.dirty = true;
     }
 }
 
-inline void buildConnect(navmesh& mesh, std::set<ivec2>& points_nosearch) {
-    while (!points_nosearch.empty()) {
-        auto sit = points_nosearch.begin();
-        ivec2 begin = *sit;
-        points_nosearch.erase(sit);
-
-        std::vector<ivec2> points_buffer;
+inline void buildPath(navmesh& mesh,
+                      int begin_id,
+                      const ivec2& begin,
+                      int target_id,
+                      const ivec2& target,
+                      int it_count = -1) {
+    wayCandidate way_c;
+    way_c.begin_id = begin_id;
+    way_c.begin = begin;
+    way_c.target_id = target_id;
+    way_c.target = target;
+    astar_array::grid atx;
+    if (findPath(mesh, way_c, atx, it_count)) {
+        commitPath(mesh, way_c);
+    }
+}
 
-        std::queue<ivec2> que{};
-        que.push(begin);
-        std::set<int> connect;
-        while (!que.empty()) {
-            const auto& pos = que.front();
-            points_buffer.push_back(pos);
+//mask中的每个连通域，如果恰好与两个节点相邻，就在两个节点间建立路线
+inline void buildConnect(navmesh& mesh, field<uint8_t>& mask) {
+    const int w = mesh.width;
+    const int h = mesh.height;
+    field<int32_t> labels(w, h);
+    std::vector<ivec2> seeds;
+    int count = ccl::label(mask, labels, seeds);
 
+    //每个连通域相邻的节点，只需要知道是否恰好两个，最多记录3个
+    //同时记录连通域和节点块的包围盒，作为路线的搜索范围
+    std::vector<std::array<int, 3>> connect(count, std::array<int, 3>{0, 0, 0});
+    std::vector<int> connectCount(count, 0);
+    std::vector<std::pair<ivec2, ivec2>> labelBox(count, std::make_pair(ivec2(w, h), ivec2(-1, -1)));
+    std::vector<std::pair<ivec2, ivec2>> nodeBox(mesh.nodes.size(), std::make_pair(ivec2(w, h), ivec2(-1, -1)));
+    auto grow = [](std::pair<ivec2, ivec2>& box, int x, int y) {
+        box.first.init(std::min(box.first.x, x), std::min(box.first.y, y));
+        box.second.init(std::max(box.second.x, x), std::max(box.second.y, y));
+    };
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            int node_id = mesh.idMap.at(x, y);
+            if (node_id > 0) {
+                grow(nodeBox.at(node_id - 1), x, y);
+            }
+            int label = labels.data[y * w + x];
+            if (label == 0) {
+                continue;
+            }
+            grow(labelBox[label - 1], x, y);
+            auto& ids = connect[label - 1];
+            auto& n = connectCount[label - 1];
             for (int i = -1; i <= 1; ++i) {
                 for (int j = -1; j <= 1; ++j) {
                     if (!(i == 0 && j == 0)) {
-                        int x = i + pos.x;
-                        int y = j + pos.y;
-                        if (x >= 0 && y >= 0 &&
-                            x < mesh.width && y < mesh.height) {
-                            auto it = points_nosearch.find(ivec2(x, y));
-                            if (it != points_nosearch.end()) {
-                                points_nosearch.erase(it);
-                                que.push(ivec2(x, y));
-                            }
-                            int id = mesh.idMap.at(x, y);
-                            if (id > 0) {
-                                connect.insert(id);
+                        int nx = i + x;
+                        int ny = j + y;
+                        if (nx >= 0 && ny >= 0 && nx < w && ny < h) {
+                            int id = mesh.idMap.at(nx, ny);
+                            if (id > 0 && n < 3 &&
+                                std::find(ids.begin(), ids.begin() + n, id) == ids.begin() + n) {
+                                ids[n++] = id;
                             }
                         }
                     }
                 }
             }
-
-            que.pop();
         }
+    }
 
-        if (connect.size() == 2) {
-            std::vector<ivec2> con_pos;
-            std::vector<int> con_id;
-            printf("connect:");
-            for (auto it : connect) {
-                auto pos = mesh.nodes.at(it - 1)->position;
-                con_pos.push_back(pos);
-                con_id.push_back(it);
-                printf("%d(%d,%d) ", it, pos.x, pos.y);
+    //先找出所有要连接的路段
+    std::vector<wayCandidate> candidates;
+    for (int c = 0; c < count; ++c) {
+        if (connectCount[c] == 2) {
+            wayCandidate way_c;
+            way_c.begin_id = std::min(connect[c][0], connect[c][1]);
+            way_c.target_id = std::max(connect[c][0], connect[c][1]);
+            way_c.begin = mesh.nodes.at(way_c.begin_id - 1)->position;
+            way_c.target = mesh.nodes.at(way_c.target_id - 1)->position;
+            //只在这个连通域和两端的节点块内搜索
+            auto box = labelBox[c];
+            for (int id : {way_c.begin_id, way_c.target_id}) {
+                grow(box, nodeBox[id - 1].first.x, nodeBox[id - 1].first.y);
+                grow(box, nodeBox[id - 1].second.x, nodeBox[id - 1].second.y);
+            }
+            way_c.areaBegin = box.first;
+            way_c.areaEnd = box.second;
+            candidates.push_back(std::move(way_c));
+        }
+    }
+    //各路段的搜索互不影响，并行执行
+    const int candidates_len = candidates.size();
+    std::vector<uint8_t> found(candidates_len, 0);
+    if (candidates_len > 0) {
+#pragma omp parallel
+        {
+            astar_array::grid atx;  //每个线程一份，重复使用，大小为最大的搜索范围
+#pragma omp for schedule(dynamic)
+            for (int c = 0; c < candidates_len; ++c) {
+                found[c] = findPath(mesh, candidates[c], atx);
             }
-            printf("\n");
-            buildPath(mesh, con_id.at(0), con_pos.at(0), con_id.at(1), con_pos.at(1));
         }
     }
+    //按连通域的顺序写入，结果与串行相同
+    for (int c = 0; c < candidates_len; ++c) {
+        if (found[c]) {
+            commitPath(mesh, candidates[c]);
+        }
+    }
+    buildAdjacency(mesh);
 }
-
-inline void buildNodeBlock(navmesh& mesh, const std::vector<ivec2>& points_block, int topSize = 2) {
+inline void buildConnect(navmesh& mesh, std::set<ivec2>& points_nosearch) {
+    field<uint8_t> mask(mesh.width, mesh.height);
+    mask.setAll(0);
+    for (auto& p : points_nosearch) {
+        mask.at(p.x, p.y) = 1;
+    }
+    points_nosearch.clear();
+    buildConnect(mesh, mask);
+}
+//thin为true时骨架来自buildIdMapThinning，用isJunction检测节点
+//border为true时骨架碰到地图边缘（山脊能到达的最外一圈）的地方也是节点，
+//分块烘焙时路线在块的边缘不会因为没有端点而被丢掉
+inline void buildNodeBlock(navmesh& mesh,
+                           const std::vector<ivec2>& points_block,
+                           int topSize = 2,
+                           bool thin = false,
+                           bool border = false) {
     int index = 1;
     std::vector<ivec2> points;
-    std::set<ivec2> points_way;
+    field<uint8_t> points_way(mesh.width, mesh.height);  //道路上的点（不含节点附近）
     std::vector<std::vector<ivec2>> blocks;
+    points_way.setAll(0);
     for (auto& p : points_block) {
-        points_way.insert(p);
+        points_way.at(p.x, p.y) = 1;
     }
+    auto onBorder = [&](const ivec2& p) {
+        return p.x <= 1 || p.y <= 1 || p.x >= mesh.width - 2 || p.y >= mesh.height - 2;
+    };
     for (auto& p : points_block) {
-        if (isNode(mesh, p)) {
+        if ((border && onBorder(p)) || (thin ? isJunction(mesh, p) : isNode(mesh, p))) {
             for (int i = -topSize; i <= topSize; ++i) {
                 for (int j = -topSize; j <= topSize; ++j) {
                     int x = i + p.x;
                     int y = j + p.y;
                     if (x >= 0 && y >= 0 &&
-                        x < mesh.idMap.width && y < mesh.idMap.width &&
+                        x < mesh.idMap.width && y < mesh.idMap.height &&
                         mesh.idMap.at(x, y) == -2) {
                         //mesh.idMap.at(x, y) = -3;
                         points.push_back(ivec2(x, y));
-                        points_way.erase(ivec2(x, y));
+                        points_way.at(x, y) = 0;
                     }
                 }
             }
@@ -603,7 +1358,9 @@ inline void buildNodeBlock(navmesh& mesh, const std::vector<ivec2>& points_block
                 auto dx = point.x - cx;
                 auto dy = point.y - cy;
                 auto len = dx * dx + dy * dy;
-                if (len < center_len) {
+                //距离相同时取x较小（再比较y）的格子，与块内的遍历顺序无关，局部重新烘焙时结果相同
+                if (len < center_len ||
+                    (len == center_len && (point.x < center.x || (point.x == center.x && point.y < center.y)))) {
                     center = point;
                     center_len = len;
                 }
@@ -617,7 +1374,7 @@ inline void buildNodeBlock(navmesh& mesh, const std::vector<ivec2>& points_block
             for (auto& point : block) {
                 auto x = point.x;
                 auto y = point.y;
-                if (x >= 0 && y >= 0 && x < mesh.idMap.width && y < mesh.idMap.width) {
+                if (x >= 0 && y >= 0 && x < mesh.idMap.width && y < mesh.idMap.height) {
                     mesh.idMap.at(x, y) = index;
                 }
             }
@@ -631,6 +1388,7 @@ inline void buildNodeBlock(navmesh& mesh, const std::vector<ivec2>& points_block
 
 //构建上路流场
 inline void buildNavFlowField(navmesh& mesh, double minPathWith) {
+    mesh.eikonalFlow = false;
     mesh.pathNavMap.setAll(pathNav(ivec2(-1, -1), -1));
     ++mesh.searchMap_id;
     std::queue<ivec2> que;
@@ -707,6 +1465,88 @@ inline void buildNavFlowField(navmesh& mesh, double minPathWith) {
     }
 }
 
+//到达时间场中沿最陡的方向下降的相邻格子（cost的降幅除以步长），没有更低的格子时返回(-1,-1)
+//不取cost最小的格子，否则斜向一步总是降得更多，路线会呈锯齿状
+template <class time_c>
+inline ivec2 steepestDescent(int x, int y, int w, int h, double t, const time_c& timeAt) {
+    ivec2 res(-1, -1);
+    double maxSlope = 0;
+    for (int k = 0; k < 8; ++k) {
+        int nx = x + neighborOffset[k][0];
+        int ny = y + neighborOffset[k][1];
+        if (nx >= 0 && ny >= 0 && nx < w && ny < h) {
+            double v = timeAt(nx, ny);
+            double slope = (t - v) * ((k & 1) ? M_SQRT1_2 : 1.);
+            if (v < t && slope > maxSlope) {
+                maxSlope = slope;
+                res.init(nx, ny);
+            }
+        }
+    }
+    return res;
+}
+//上路流场的慢度，路宽不超过minPathWith时加上与buildNavFlowField相同的惩罚
+inline double navSlowness(navmesh& mesh, int x, int y, double minPathWith) {
+    double pathWidth = mesh.getSdf(x, y);
+    if (pathWidth == 0) {
+        pathWidth = 0.000001;
+    }
+    double s = 1;
+    if (pathWidth <= minPathWith) {
+        s += 1000. / pathWidth;  //太窄，逃离
+    }
+    return s;
+}
+
+//构建上路流场（程函方程）
+//与buildNavFlowField的路宽惩罚相同，慢度为1+1000/路宽（路宽不超过minPathWith时），
+//用快速行进法求出到路线的加权距离作为cost，target为8邻域中下降最陡的格子
+inline void buildNavFlowFieldEikonal(navmesh& mesh, double minPathWith) {
+    const int w = mesh.width;
+    const int h = mesh.height;
+    mesh.eikonalFlow = true;
+    field<double> slowness(w, h);
+#pragma omp parallel for
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            slowness.data[y * w + x] = navSlowness(mesh, x, y, minPathWith);
+        }
+    }
+
+    std::vector<ivec2> seeds;
+    for (auto& it : mesh.ways) {
+        for (auto& p : it.second->maxPath) {
+            seeds.push_back(p);
+        }
+    }
+    for (auto& it : mesh.nodes) {
+        seeds.push_back(it->position);
+    }
+    field<double> time(w, h);
+    eikonal::march(time, slowness, seeds);
+
+    ++mesh.searchMap_id;
+#pragma omp parallel for
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            double t = time.data[y * w + x];
+            auto& res = mesh.pathNavMap.at(x, y);
+            if (t == 0) {
+                res = pathNav(ivec2(-1, -1), 0);
+                continue;
+            }
+            ivec2 minConn_pos = steepestDescent(x, y, w, h, t, [&](int nx, int ny) {
+                return time.data[ny * w + nx];
+            });
+            if (minConn_pos.x < 0) {  //无法到达
+                res = pathNav(ivec2(-1, -1), -1);
+            } else {
+                res = pathNav(minConn_pos, t);
+            }
+        }
+    }
+}
+
 //删除孤立的路线
 inline void removeWaste(navmesh& mesh, std::vector<ivec2>& points) {
     auto len = points.size();
@@ -734,6 +1574,93 @@ inline void removeWaste(navmesh& mesh, std::vector<ivec2>& points) {
     }
 }
 
+//删除keep为0的节点、与它们相连的路线以及它们所在的山脊（在idMap中变为-1，与removeWaste删掉的相同）
+//剩下的节点按原顺序重新编号，路线的键和两端的先后不变；之后需要重新生成邻接表和上路流场
+inline void removeNodes(navmesh& mesh, const std::vector<uint8_t>& keep) {
+    const int w = mesh.width;
+    const int h = mesh.height;
+    const int n = mesh.nodes.size();
+    std::vector<int32_t> newId(n + 1, 0);
+    int32_t next = 1;
+    for (int i = 0; i < n; ++i) {
+        if (keep[i]) {
+            newId[i + 1] = next++;
+        }
+    }
+    //删除的节点所在的山脊
+    ++mesh.searchMap_id;
+    std::queue<ivec2> que;
+    for (int i = 0; i < n; ++i) {
+        if (!keep[i]) {
+            auto& p = mesh.nodes[i]->position;
+            mesh.searchMap.at(p.x, p.y) = mesh.searchMap_id;
+            que.push(p);
+        }
+    }
+    while (!que.empty()) {
+        auto pos = que.front();
+        que.pop();
+        mesh.idMap.at(pos.x, pos.y) = -1;
+        for (int k = 0; k < 8; ++k) {
+            int x = pos.x + neighborOffset[k][0];
+            int y = pos.y + neighborOffset[k][1];
+            if (x >= 0 && y >= 0 && x < w && y < h &&
+                mesh.searchMap.at(x, y) != mesh.searchMap_id) {
+                int32_t id = mesh.idMap.at(x, y);
+                if (id == -2 || (id > 0 && !newId[id])) {
+                    mesh.searchMap.at(x, y) = mesh.searchMap_id;
+                    que.push(ivec2(x, y));
+                }
+            }
+        }
+    }
+    //路线
+    std::map<std::pair<int32_t, int32_t>, std::unique_ptr<way>> ways;
+    for (auto& it : mesh.ways) {
+        int32_t a = newId[it.first.first];
+        int32_t b = newId[it.first.second];
+        auto& l = it.second;
+        if (a && b) {
+            ways[std::make_pair(a, b)] = std::move(l);
+        } else {
+            l->p1->ways.erase(l.get());
+            l->p2->ways.erase(l.get());
+        }
+    }
+    mesh.ways = std::move(ways);
+    mesh.graph.dirty = true;
+    //节点
+    std::vector<std::unique_ptr<node>> nodes;
+    for (int i = 0; i < n; ++i) {
+        if (keep[i]) {
+            mesh.nodes[i]->id = newId[i + 1];
+            nodes.push_back(std::move(mesh.nodes[i]));
+        }
+    }
+    mesh.nodes = std::move(nodes);
+    //idMap中的节点块和pathDis中的节点id
+#pragma omp parallel for
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            auto& id = mesh.idMap.at(x, y);
+            if (id > 0) {
+                id = newId[id];
+            }
+            auto& d = mesh.pathDisMap.at(x, y);
+            if (d.firstNode > 0) {
+                int32_t a = newId[d.firstNode];
+                int32_t b = d.secondNode > 0 ? newId[d.secondNode] : 0;
+                if (!a || (d.secondNode > 0 && !b)) {
+                    d = pathDis();
+                } else {
+                    d.firstNode = a;
+                    d.secondNode = b;
+                }
+            }
+        }
+    }
+}
+
 //导航至路上
 inline bool toRoad(navmesh& mesh,
                    const ivec2& pos,             //起点（输入）
@@ -744,8 +1671,7 @@ inline bool toRoad(navmesh& mesh,
     ivec2 conn_pos = pos;
     while (conn_pos.x >= 0 || conn_pos.y >= 0) {
         pathPos.push_back(conn_pos);
-        auto& pathNavMapValue = mesh.pathNavMap.at(conn_pos.x, conn_pos.y);
-        conn_pos = pathNavMapValue.target;
+        conn_pos = mesh.getPathNav(conn_pos.x, conn_pos.y).target;
     }
     if (pathPos.empty()) {
         return false;
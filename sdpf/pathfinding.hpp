@@ -15,7 +15,7 @@ inline void buildTmpWay(navmesh::navmesh& mesh,
     bool rev = false;
     //bool lengthRev = false;
     //auto targetNode = mesh.nodes.at(targetId - 1).get();
-    auto targetBlock = mesh.pathDisMap.at(start.x, start.y);
+    auto targetBlock = mesh.getPathDis(start.x, start.y);
     int a = targetBlock.firstNode;
     int b = targetBlock.secondNode;
     int startIndex = targetBlock.pointIndex;
@@ -45,7 +45,7 @@ inline void buildTmpWay(navmesh::navmesh& mesh,
             for (int i = startIndex; i >= 0; --i) {
                 way.maxPath.push_back(path[i]);
                 way.minWidth = std::min(way.minWidth,
-                                        mesh.sdfMap.at(path[i].x, path[i].y));
+                                        mesh.getSdf(path[i].x, path[i].y));
                 if (!first) {
                     lenSum += path[i].length(last);
                 }
@@ -56,7 +56,7 @@ inline void buildTmpWay(navmesh::navmesh& mesh,
             for (int i = startIndex; i < len; ++i) {
                 way.maxPath.push_back(path[i]);
                 way.minWidth = std::min(way.minWidth,
-                                        mesh.sdfMap.at(path[i].x, path[i].y));
+                                        mesh.getSdf(path[i].x, path[i].y));
                 if (!first) {
                     lenSum += path[i].length(last);
                 }
@@ -69,12 +69,66 @@ inline void buildTmpWay(navmesh::navmesh& mesh,
     }
 }
 
-inline void buildNodePath(navmesh::navmesh& mesh,    //mesh
-                          vec2 begin,                //起点
-                          vec2 target,               //终点
-                          std::vector<ivec2>& path,  //最终路线
-                          int it_count = 512,        //迭代次数
-                          double minPathWidth = 8) {
+//用按id索引的A*求begin到target的路线，extra为连接临时起点、终点的路线
+//路宽不超过minPathWidth的路线不能通过（临时路线除外），it_count为最多展开的节点数，小于0不限制
+inline bool searchNodePath(navmesh::navmesh& mesh,
+                           astar_node::graph& atx,
+                           navmesh::node* begin,
+                           navmesh::node* target,
+                           const navmesh::queryEdges& extra,
+                           std::vector<ivec2>& path,
+                           int it_count,
+                           double minPathWidth) {
+    navmesh::updateAdjacency(mesh);
+    atx.reserve(mesh.nodes.size());
+    bool found = astar_node::search(
+        atx, begin, target, [&](navmesh::node* n, auto emit) {
+            navmesh::forEachEdge(mesh, n, extra, [&](navmesh::node* other, navmesh::way* w) {
+                if (w->minWidth > minPathWidth || other->id < 0 || n->id < 0) {  //可以通过
+                    emit(other, w->length);
+                }
+            });
+        },
+        it_count);
+    if (!found) {
+        return false;
+    }
+    //从终点回溯得到的节点序列，翻转后按相邻两个节点之间的路线拼接
+    std::vector<navmesh::node*> nodes;
+    astar_node::buildRoad(atx, [&](navmesh::node* n) {
+        nodes.push_back(n);
+    });
+    std::reverse(nodes.begin(), nodes.end());
+    for (size_t i = 1; i < nodes.size(); ++i) {
+        auto from = nodes[i - 1];
+        auto to = nodes[i];
+        navmesh::way* w = nullptr;
+        navmesh::forEachEdge(mesh, from, extra, [&](navmesh::node* other, navmesh::way* it) {
+            if (other == to) {
+                w = it;
+            }
+        });
+        if (w == nullptr) {
+            path.clear();
+            return false;
+        }
+        if (w->p1 == from) {
+            path.insert(path.end(), w->maxPath.begin(), w->maxPath.end());
+        } else {
+            path.insert(path.end(), w->maxPath.rbegin(), w->maxPath.rend());
+        }
+    }
+    return true;
+}
+
+//atx不为空时用A*（searchNodePath）搜索，否则用流场
+inline void buildNodePath(navmesh::navmesh& mesh,                //mesh
+                          vec2 begin,                            //起点
+                          vec2 target,                           //终点
+                          std::vector<ivec2>& path,              //最终路线
+                          int it_count = 512,                    //迭代次数
+                          double minPathWidth = 8,               //最小路宽（只用于A*）
+                          astar_node::graph* atx = nullptr) {  //A*的搜索状态，可以在多次查询间复用
     std::vector<ivec2> pathWayStart, pathWayTarget;
     ivec2 wayStart, wayEnd;
     //利用流场求解道路上的起止点
@@ -95,7 +149,7 @@ inline void buildNodePath(navmesh::navmesh& mesh,    //mesh
             if (!first) {
                 wayStartLen += it.length(last);
             }
-            wayStartMinWidth = std::min(wayStartMinWidth, mesh.sdfMap.at(it.x, it.y));
+            wayStartMinWidth = std::min(wayStartMinWidth, mesh.getSdf(it.x, it.y));
             first = false;
             last = it;
         }
@@ -109,7 +163,7 @@ inline void buildNodePath(navmesh::navmesh& mesh,    //mesh
             if (!first) {
                 wayTargetLen += it.length(last);
             }
-            wayTargetMinWidth = std::min(wayTargetMinWidth, mesh.sdfMap.at(it.x, it.y));
+            wayTargetMinWidth = std::min(wayTargetMinWidth, mesh.getSdf(it.x, it.y));
             first = false;
             last = it;
         }
@@ -118,12 +172,13 @@ inline void buildNodePath(navmesh::navmesh& mesh,    //mesh
 
     //printf("wayStart=(%d,%d) wayEnd=(%d,%d)\n", wayStart.x, wayStart.y, wayEnd.x, wayEnd.y);
 
-    auto& dStart = mesh.pathDisMap.at(wayStart.x, wayStart.y);
-    auto& dEnd = mesh.pathDisMap.at(wayEnd.x, wayEnd.y);
+    auto dStart = mesh.getPathDis(wayStart.x, wayStart.y);
+    auto dEnd = mesh.getPathDis(wayEnd.x, wayEnd.y);
     //构造临时节点
     navmesh::node dStart_node_tmp;
     dStart_node_tmp.flowFieldFlag = 0;
     dStart_node_tmp.id = -1;
+    dStart_node_tmp.position = pathWayStart.front();  //A*的启发函数用到临时节点的位置
     navmesh::way dStart_way1, dStart_way2;
     dStart_way1.maxPath = pathWayStart;
     dStart_way1.length = wayStartLen;
@@ -137,6 +192,7 @@ inline void buildNodePath(navmesh::navmesh& mesh,    //mesh
     navmesh::node dTarget_node_tmp;
     dTarget_node_tmp.flowFieldFlag = 0;
     dTarget_node_tmp.id = -2;
+    dTarget_node_tmp.position = pathWayTarget.front();
     navmesh::way dTarget_way1, dTarget_way2;
     dTarget_way1.maxPath = pathWayTarget;
     dTarget_way1.length = wayTargetLen;
@@ -147,7 +203,7 @@ inline void buildNodePath(navmesh::navmesh& mesh,    //mesh
     dTarget_way2.minWidth = wayTargetMinWidth;
     dTarget_way2.p1 = &dTarget_node_tmp;
 
-    std::vector<navmesh::node*> nodeClearList;
+    navmesh::queryEdges extra;  //临时路线，不修改节点
 
     //构造临时路线
     int dStart_id1 = dStart.firstNode;
@@ -164,52 +220,44 @@ inline void buildNodePath(navmesh::navmesh& mesh,    //mesh
     if (dStart_id2 <= 0) {  //直达
         auto dStart_node1 = mesh.nodes.at(dStart_id1 - 1).get();
         dStart_way1.p2 = dStart_node1;
-        dStart_node_tmp.ways.insert(&dStart_way1);
-        dStart_node1->tmpways.insert(&dStart_way1);
-        nodeClearList.push_back(dStart_node1);
+        extra.add(&dStart_way1);
     } else {
         auto dStart_node1 = mesh.nodes.at(dStart_id1 - 1).get();
         dStart_way1.p2 = dStart_node1;
         buildTmpWay(mesh, dStart_way1, wayStart, dStart_id1);
-        dStart_node_tmp.ways.insert(&dStart_way1);
-        dStart_node1->tmpways.insert(&dStart_way1);
-        nodeClearList.push_back(dStart_node1);
+        extra.add(&dStart_way1);
 
         auto dStart_node2 = mesh.nodes.at(dStart_id2 - 1).get();
         dStart_way2.p2 = dStart_node2;
         buildTmpWay(mesh, dStart_way2, wayStart, dStart_id2);
-        dStart_node_tmp.ways.insert(&dStart_way2);
-        dStart_node2->tmpways.insert(&dStart_way2);
-        nodeClearList.push_back(dStart_node2);
+        extra.add(&dStart_way2);
     }
 
     if (dEnd_id2 <= 0) {  //直达
         auto dEnd_node1 = mesh.nodes.at(dEnd_id1 - 1).get();
         dTarget_way1.p2 = dEnd_node1;
-        dTarget_node_tmp.ways.insert(&dTarget_way1);
-        dEnd_node1->tmpways.insert(&dTarget_way1);
-        nodeClearList.push_back(dEnd_node1);
+        extra.add(&dTarget_way1);
     } else {
         auto dEnd_node1 = mesh.nodes.at(dEnd_id1 - 1).get();
         dTarget_way1.p2 = dEnd_node1;
         buildTmpWay(mesh, dTarget_way1, wayEnd, dEnd_id1);
-        dTarget_node_tmp.ways.insert(&dTarget_way1);
-        dEnd_node1->tmpways.insert(&dTarget_way1);
-        nodeClearList.push_back(dEnd_node1);
+        extra.add(&dTarget_way1);
 
         auto dEnd_node2 = mesh.nodes.at(dEnd_id2 - 1).get();
         dTarget_way2.p2 = dEnd_node2;
         buildTmpWay(mesh, dTarget_way2, wayEnd, dEnd_id2);
-        dTarget_node_tmp.ways.insert(&dTarget_way2);
-        dEnd_node2->tmpways.insert(&dTarget_way2);
-        nodeClearList.push_back(dEnd_node2);
+        extra.add(&dTarget_way2);
     }
 
     //构造路线
     path.clear();
+    if (atx) {
+        searchNodePath(mesh, *atx, &dStart_node_tmp, &dTarget_node_tmp, extra, path, it_count, minPathWidth);
+        return;
+    }
     //使用流场的寻路方式
     //printf("buildMeshFlowField\n");
-    navmesh::buildMeshFlowField(mesh, &dTarget_node_tmp);  //流场寻路只需要终点
+    navmesh::buildMeshFlowField(mesh, &dTarget_node_tmp, extra);  //流场寻路只需要终点
     //printf("dStart_node_tmp.id=%d\n", dStart_node_tmp.id);
     navmesh::node* targetNavNode = &dStart_node_tmp;
     //navmesh::node* last = nullptr;
@@ -240,96 +288,6 @@ inline void buildNodePath(navmesh::navmesh& mesh,    //mesh
             break;
         }
     }
-    for (auto it : nodeClearList) {
-        it->tmpways.clear();
-    }
-    /*
-    //使用a*的寻路方式
-    astar_node::context atx;
-    astar_node::start(
-        atx, &dStart_node_tmp, &dTarget_node_tmp, [&](const auto& node, auto callback) {
-            //printf("find path id:%d\n", node->id);
-            for (auto it : node->ways) {
-                //printf("way:%d %d minWidth=%lf\n", it->p1->id, it->p2->id, it->minWidth);
-                navmesh::node* targetNavNode;
-                if (it->minWidth > minPathWidth) {  //可以通过
-                    if (it->p1 == node) {
-                        targetNavNode = it->p2;
-                    } else {
-                        targetNavNode = it->p1;
-                    }
-                    //printf("con:%d\n", targetNavNode->id);
-                    callback(targetNavNode, it->length);
-                }
-            }
-            if (node->id == dEnd_id1) {
-                //printf("con:end1\n");
-                callback(&dTarget_node_tmp, dTarget_way1.length);
-            }
-            if (node->id == dEnd_id2) {
-                //printf("con:end2\n");
-                callback(&dTarget_node_tmp, dTarget_way2.length);
-            }
-        },
-        it_count);
-    int lastNode = 0;
-    astar_node::buildRoad(atx, [&](navmesh::node* n) {
-        //printf("id:%d\n", n->id);
-        bool rev = 0;
-        if (lastNode == -2) {
-            if (dTarget_way1.p2 == n) {
-                auto& nodepath = dTarget_way1.maxPath;
-                for (auto itp = nodepath.begin(); itp != nodepath.end(); ++itp) {
-                    path.push_back(*itp);
-                }
-            } else if (dTarget_way2.p2 == n) {
-                auto& nodepath = dTarget_way2.maxPath;
-                for (auto itp = nodepath.begin(); itp != nodepath.end(); ++itp) {
-                    path.push_back(*itp);
-                }
-            }
-        } else if (lastNode > 0) {
-            if (n->id == -1) {
-                if (dStart_way1.p2->id == lastNode) {
-                    auto& nodepath = dStart_way1.maxPath;
-                    for (auto itp = nodepath.rbegin(); itp != nodepath.rend(); ++itp) {
-                        path.push_back(*itp);
-                    }
-                } else if (dStart_way2.p2->id == lastNode) {
-                    auto& nodepath = dStart_way2.maxPath;
-                    for (auto itp = nodepath.rbegin(); itp != nodepath.rend(); ++itp) {
-                        path.push_back(*itp);
-                    }
-                }
-            } else if (n->id > 0) {
-                int a = lastNode;
-                int b = n->id;
-                if (a > b) {
-                    std::swap(a, b);
-                    rev = !rev;
-                }
-                auto pair = std::make_pair(a, b);
-                auto it = mesh.ways.find(pair);
-                if (it != mesh.ways.end()) {
-                    auto& nodepath = it->second->maxPath;
-                    if (!rev) {
-                        for (auto itp = nodepath.begin(); itp != nodepath.end(); ++itp) {
-                            path.push_back(*itp);
-                        }
-                    } else {
-                        for (auto itp = nodepath.rbegin(); itp != nodepath.rend(); ++itp) {
-                            path.push_back(*itp);
-                        }
-                    }
-                }
-            }
-        }
-        lastNode = n->id;
-    });
-    //a*从起点开始搜索，从终点开始构建路线，完成后需要翻转路线
-    //流场寻路从终点开始搜索，从起点开始构建路线，故无须此操作
-    std::reverse(path.begin(), path.end());
-    */
 }
 
 template <typename T>
@@ -354,12 +312,12 @@ inline void buildNodePath(navmesh::navmesh& mesh,  //mesh
             if (!first) {
                 wayTargetLen += it.length(last);
             }
-            wayTargetMinWidth = std::min(wayTargetMinWidth, mesh.sdfMap.at(it.x, it.y));
+            wayTargetMinWidth = std::min(wayTargetMinWidth, mesh.getSdf(it.x, it.y));
             first = false;
             last = it;
         }
     }
-    auto& dEnd = mesh.pathDisMap.at(wayEnd.x, wayEnd.y);
+    auto dEnd = mesh.getPathDis(wayEnd.x, wayEnd.y);
     //构造临时节点
 
     navmesh::node dTarget_node_tmp;
@@ -375,7 +333,7 @@ inline void buildNodePath(navmesh::navmesh& mesh,  //mesh
     dTarget_way2.minWidth = wayTargetMinWidth;
     dTarget_way2.p1 = &dTarget_node_tmp;
 
-    std::vector<navmesh::node*> nodeClearList;
+    navmesh::queryEdges extra;  //临时路线，不修改节点
 
     //构造临时路线
     //int dStart_id1 = dStart.firstNode;
@@ -392,28 +350,22 @@ inline void buildNodePath(navmesh::navmesh& mesh,  //mesh
     if (dEnd_id2 <= 0) {  //直达
         auto dEnd_node1 = mesh.nodes.at(dEnd_id1 - 1).get();
         dTarget_way1.p2 = dEnd_node1;
-        dTarget_node_tmp.ways.insert(&dTarget_way1);
-        dEnd_node1->tmpways.insert(&dTarget_way1);
-        nodeClearList.push_back(dEnd_node1);
+        extra.add(&dTarget_way1);
     } else {
         auto dEnd_node1 = mesh.nodes.at(dEnd_id1 - 1).get();
         dTarget_way1.p2 = dEnd_node1;
         buildTmpWay(mesh, dTarget_way1, wayEnd, dEnd_id1);
-        dTarget_node_tmp.ways.insert(&dTarget_way1);
-        dEnd_node1->tmpways.insert(&dTarget_way1);
-        nodeClearList.push_back(dEnd_node1);
+        extra.add(&dTarget_way1);
 
         auto dEnd_node2 = mesh.nodes.at(dEnd_id2 - 1).get();
         dTarget_way2.p2 = dEnd_node2;
         buildTmpWay(mesh, dTarget_way2, wayEnd, dEnd_id2);
-        dTarget_node_tmp.ways.insert(&dTarget_way2);
-        dEnd_node2->tmpways.insert(&dTarget_way2);
-        nodeClearList.push_back(dEnd_node2);
+        extra.add(&dTarget_way2);
     }
 
     //使用流场的寻路方式
     //printf("buildMeshFlowField\n");
-    navmesh::buildMeshFlowField(mesh, &dTarget_node_tmp);  //流场寻路只需要终点
+    navmesh::buildMeshFlowField(mesh, &dTarget_node_tmp, extra);  //流场寻路只需要终点
 
     for (auto& it : activeNodes) {
         //利用流场求解道路上的起止点
@@ -434,14 +386,14 @@ inline void buildNodePath(navmesh::navmesh& mesh,  //mesh
                     if (!first) {
                         wayStartLen += it.length(last);
                     }
-                    wayStartMinWidth = std::min(wayStartMinWidth, mesh.sdfMap.at(it.x, it.y));
+                    wayStartMinWidth = std::min(wayStartMinWidth, mesh.getSdf(it.x, it.y));
                     first = false;
                     last = it;
                 }
             }
 
             it->path = it->pathWayStart;
-            auto& dStart = mesh.pathDisMap.at(it->wayStart.x, it->wayStart.y);
+            auto dStart = mesh.getPathDis(it->wayStart.x, it->wayStart.y);
 
             //构造临时路线
             int dStart_id1 = dStart.firstNode;
@@ -516,9 +468,6 @@ inline void buildNodePath(navmesh::navmesh& mesh,  //mesh
         }
     }
 
-    for (auto it : nodeClearList) {
-        it->tmpways.clear();
-    }
 }
 
 }  // namespace sdpf::pathfinding
\ No newline at end of file
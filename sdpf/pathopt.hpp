@@ -53,6 +53,52 @@ inline bool rayMarch(sdf::sdf& map,       //导航地图
     return false;
 }
 
+//检查线段上的距离是否都不小于path_width
+//建立了最小值金字塔时由粗到细：整段包围盒的下界满足就直接通过，否则二分，
+//只有靠近障碍物的短线段才逐步采样
+inline bool segmentClear(sdf::sdf& map,      //导航地图
+                         const vec2& begin,  //起点
+                         const vec2& end,    //终点
+                         double path_width   //线宽
+) {
+    const double fineLen = 8. / map.scale;  //不再细分的长度（约8个像素）
+    std::vector<std::pair<vec2, vec2>> stack;
+    stack.emplace_back(begin, end);
+    while (!stack.empty()) {
+        auto [a, b] = stack.back();
+        stack.pop_back();
+        if (map.minPyramid) {
+            vec2 lo(std::min(a.x, b.x), std::min(a.y, b.y));
+            vec2 hi(std::max(a.x, b.x), std::max(a.y, b.y));
+            if (map.minInBox(lo, hi) >= path_width) {
+                continue;
+            }
+            double len = a.length(b);
+            if (len > fineLen) {
+                vec2 mid = (a + b) / 2;
+                stack.emplace_back(mid, b);
+                stack.emplace_back(a, mid);
+                continue;
+            }
+        }
+        //逐步采样，步长取多出路宽的部分
+        double len = a.length(b);
+        vec2 dir = len > 0 ? (b - a) / len : vec2(0, 0);
+        double t = 0;
+        while (true) {
+            double dis = map[a + dir * t];
+            if (dis < path_width) {
+                return false;
+            }
+            if (t >= len) {
+                break;
+            }
+            t = std::min(len, t + std::max(dis - path_width, 0.1 / map.scale));
+        }
+    }
+    return true;
+}
+
 //发射一系列光线扫描，获取最远的点
 inline int getFarPoint(const std::vector<vec2>& path_in,  //原始路线
                        sdf::sdf& map,                     //导航地图
@@ -104,11 +150,8 @@ inline int getFarPoint(const std::vector<vec2>& path_in,  //原始路线
         for (int i = 0; i < 8; ++i) {
             auto mid = (left + right) / 2.;
             auto movePoint = nowPoint + dir * mid;
-            vec2 nearestPoint;
-            //发射光线
-            if (rayMarch(map,
-                         movePoint, target,
-                         path_width, nearestPoint)) {
+            //只需要知道是否通过，用segmentClear（有金字塔时由粗到细检查）
+            if (!segmentClear(map, movePoint, target, path_width)) {
                 //如果发生碰撞，nearestPoint为无效值，区间往前
                 left = mid;
             } else {
@@ -141,7 +184,7 @@ inline bool optPath(const std::vector<vec2>& path_in,  //原始路线
             return false;
         }
         auto pos = path_in.at(startPathId);
-        if (map.at(pos.x, pos.y) > path_width) {
+        if (map.value(pos.x, pos.y) > path_width) {
             break;
         }
         ++startPathId;
@@ -1,15 +1,20 @@
 #pragma once
+#include <omp.h>
+#include <stdint.h>
+#include <unordered_set>
+#include <vector>
 #include "KDTree.hpp"
 #include "navmesh.hpp"
 
 //点云处理
 namespace sdpf::pointcloud {
 
-void getPointDis(KDTree& tree, const vec2& pos, vec2& dis, vec2& target) {
-    auto res = tree.nearest_point(std::vector<double>({pos.x, pos.y}));
-    if (!res.empty()) {
-        //printf("search:(%lf,%lf)=>(%lf,%lf)\n", pos.x, pos.y, res->val.at(0), res->val.at(1));
-        target = vec2(res.at(0), res.at(1));
+inline void getPointDis(const KDTree& tree, const vec2& pos, vec2& dis, vec2& target) {
+    KDPoint res;
+    double res_dist2;
+    if (tree.nearest(pos, res, res_dist2)) {
+        //printf("search:(%lf,%lf)=>(%lf,%lf)\n", pos.x, pos.y, res.pos.x, res.pos.y);
+        target = res.pos;
         dis = target - pos;
     } else {
         target = vec2(0, 0);
@@ -17,4 +22,87 @@ void getPointDis(KDTree& tree, const vec2& pos, vec2& dis, vec2& target) {
     }
 }
 
+//体素降采样：把点按cellSize吸附到格子上，每个格子只保留输入中最先出现的点
+//cellSize一般取导航网格的大小或更小，这样树的大小只与地图面积有关
+//points_in和points_out可以是同一个数组
+inline void downsample(const std::vector<vec2>& points_in,
+                       std::vector<vec2>& points_out,
+                       double cellSize = 1.0) {
+    int64_t len = points_in.size();
+    if (len == 0 || cellSize <= 0) {
+        points_out = points_in;
+        return;
+    }
+    //计算格子编号及其哈希分桶
+    const uint32_t bucket_count = 64 * omp_get_max_threads();
+    double invCell = 1. / cellSize;
+    std::vector<uint64_t> keys(len);
+    std::vector<uint32_t> buckets(len);
+#pragma omp parallel for
+    for (int64_t i = 0; i < len; ++i) {
+        auto cx = (int64_t)floor(points_in[i].x * invCell);
+        auto cy = (int64_t)floor(points_in[i].y * invCell);
+        uint64_t key = ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy;
+        keys[i] = key;
+        //splitmix64
+        uint64_t h = key + 0x9e3779b97f4a7c15ull;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+        h = h ^ (h >> 31);
+        buckets[i] = h % bucket_count;
+    }
+    //按桶排列点的下标（桶内保持输入顺序）
+    std::vector<int64_t> bucket_begin(bucket_count + 1, 0);
+    for (int64_t i = 0; i < len; ++i) {
+        ++bucket_begin[buckets[i] + 1];
+    }
+    for (uint32_t b = 0; b < bucket_count; ++b) {
+        bucket_begin[b + 1] += bucket_begin[b];
+    }
+    std::vector<int64_t> order(len);
+    {
+        std::vector<int64_t> bucket_pos(bucket_begin.begin(), bucket_begin.end() - 1);
+        for (int64_t i = 0; i < len; ++i) {
+            order[bucket_pos[buckets[i]]++] = i;
+        }
+    }
+    //各桶互不相交，可以并行去重
+    std::vector<unsigned char> keep(len, 0);
+#pragma omp parallel
+    {
+        std::unordered_set<uint64_t> seen;
+#pragma omp for schedule(dynamic)
+        for (uint32_t b = 0; b < bucket_count; ++b) {
+            seen.clear();
+            for (int64_t k = bucket_begin[b]; k < bucket_begin[b + 1]; ++k) {
+                auto i = order[k];
+                if (seen.insert(keys[i]).second) {
+                    keep[i] = 1;
+                }
+            }
+        }
+    }
+    //先写到局部数组再交换，原地调用时不会在读完之前清空输入
+    std::vector<vec2> res;
+    for (int64_t i = 0; i < len; ++i) {
+        if (keep[i]) {
+            res.push_back(points_in[i]);
+        }
+    }
+    points_out.swap(res);
+}
+
+inline void downsample(std::vector<point_t>& points, double cellSize = 1.0) {
+    std::vector<vec2> points_in, points_out;
+    points_in.reserve(points.size());
+    for (auto& it : points) {
+        points_in.push_back(vec2(it.at(0), it.at(1)));
+    }
+    downsample(points_in, points_out, cellSize);
+    points.clear();
+    for (auto& it : points_out) {
+        points.push_back({it.x, it.y});
+    }
+}
+
 }  // namespace sdpf::pointcloud
\ No newline at end of file
@@ -0,0 +1,809 @@
+#pragma once
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <set>
+#include <vector>
+#include "eikonal.hpp"
+#include "navmesh.hpp"
+//局部重新烘焙
+//障碍物变化并用updateSdfMap更新sdf后，只重建脏矩形附近的山脊、节点和路线，
+//与外面没有受影响的路网重新连接，节点id保持连续，再只重算cost可能变化的那部分上路流场
+namespace sdpf::rebake {
+
+//矩形（闭区间）
+struct rect {
+    ivec2 begin{0, 0};
+    ivec2 end{-1, -1};
+    inline bool empty() const {
+        return end.x < begin.x || end.y < begin.y;
+    }
+    inline void add(const ivec2& p) {
+        if (empty()) {
+            begin = p;
+            end = p;
+        } else {
+            begin.init(std::min(begin.x, p.x), std::min(begin.y, p.y));
+            end.init(std::max(end.x, p.x), std::max(end.y, p.y));
+        }
+    }
+    inline void add(const rect& r) {
+        if (!r.empty()) {
+            add(r.begin);
+            add(r.end);
+        }
+    }
+    inline bool contains(int x, int y) const {
+        return x >= begin.x && y >= begin.y && x <= end.x && y <= end.y;
+    }
+    //与闭区间[b, e]相交
+    inline bool meets(const ivec2& b, const ivec2& e) const {
+        return !empty() && b.x <= end.x && b.y <= end.y && e.x >= begin.x && e.y >= begin.y;
+    }
+    //向外扩m格，截断到地图内
+    inline rect expand(int m, int w, int h) const {
+        rect res;
+        if (!empty()) {
+            res.begin.init(std::max(begin.x - m, 0), std::max(begin.y - m, 0));
+            res.end.init(std::min(end.x + m, w - 1), std::min(end.y + m, h - 1));
+        }
+        return res;
+    }
+    template <class callback_c>
+    inline void forEach(const callback_c& callback) const {
+        for (int y = begin.y; y <= end.y; ++y) {
+            for (int x = begin.x; x <= end.x; ++x) {
+                callback(x, y);
+            }
+        }
+    }
+};
+
+//删除一条路线，清掉它写入的pathDis，changed记录路线上的格子
+inline void removeWay(navmesh::navmesh& mesh,
+                      std::map<std::pair<int32_t, int32_t>, std::unique_ptr<navmesh::way>>::iterator it,
+                      rect& changed) {
+    auto& key = it->first;
+    auto& w = *it->second;
+    for (auto& p : w.maxPath) {
+        auto& d = mesh.pathDisMap.at(p.x, p.y);
+        if ((d.firstNode == key.first && d.secondNode == key.second) ||
+            (d.firstNode == key.second && d.secondNode == key.first)) {
+            d = navmesh::pathDis();
+        }
+        changed.add(p);
+    }
+    w.p1->ways.erase(&w);
+    w.p2->ways.erase(&w);
+    mesh.ways.erase(it);
+    mesh.graph.dirty = true;
+}
+
+//与p八连通、idMap为id的格子
+template <class callback_c>
+inline void floodId(navmesh::navmesh& mesh, const ivec2& p, int32_t id, const callback_c& callback) {
+    ++mesh.searchMap_id;
+    std::queue<ivec2> que;
+    que.push(p);
+    mesh.searchMap.at(p.x, p.y) = mesh.searchMap_id;
+    while (!que.empty()) {
+        auto pos = que.front();
+        que.pop();
+        callback(pos);
+        for (int k = 0; k < 8; ++k) {
+            int x = pos.x + navmesh::neighborOffset[k][0];
+            int y = pos.y + navmesh::neighborOffset[k][1];
+            if (x >= 0 && y >= 0 && x < mesh.width && y < mesh.height &&
+                mesh.idMap.at(x, y) == id &&
+                mesh.searchMap.at(x, y) != mesh.searchMap_id) {
+                mesh.searchMap.at(x, y) = mesh.searchMap_id;
+                que.push(ivec2(x, y));
+            }
+        }
+    }
+}
+
+//把节点from改为to（to的位置必须是空的），同时修改idMap、路线的键和pathDis
+//路线两端的先后顺序变化时翻转maxPath
+inline void moveNode(navmesh::navmesh& mesh, int32_t from, int32_t to) {
+    auto n = std::move(mesh.nodes.at(from - 1));
+    n->id = to;
+    floodId(mesh, n->position, from, [&](const ivec2& p) {
+        mesh.idMap.at(p.x, p.y) = to;
+    });
+    auto& center = mesh.pathDisMap.at(n->position.x, n->position.y);
+    if (center.firstNode == from && center.secondNode == 0) {
+        center.firstNode = to;
+    }
+    std::vector<navmesh::way*> ways(n->ways.begin(), n->ways.end());
+    for (auto w : ways) {
+        int32_t oldA = w->p1 == n.get() ? from : w->p1->id;
+        int32_t oldB = w->p2 == n.get() ? from : w->p2->id;
+        auto handle = mesh.ways.extract(std::make_pair(oldA, oldB));
+        if (handle.empty()) {
+            continue;
+        }
+        const int len = w->maxPath.size();
+        bool reversed = w->p1->id > w->p2->id;
+        if (reversed) {
+            std::swap(w->p1, w->p2);
+            std::reverse(w->maxPath.begin(), w->maxPath.end());
+        }
+        for (int i = 0; i < len; ++i) {
+            auto& p = w->maxPath[i];
+            auto& d = mesh.pathDisMap.at(p.x, p.y);
+            int oldIndex = reversed ? len - 1 - i : i;
+            if (d.pointIndex != oldIndex ||
+                !((d.firstNode == oldA && d.secondNode == oldB) ||
+                  (d.firstNode == oldB && d.secondNode == oldA))) {
+                continue;
+            }
+            if (d.firstNode == from) {
+                d.firstNode = to;
+            } else {
+                d.secondNode = to;
+            }
+            d.pointIndex = i;
+        }
+        handle.key() = std::make_pair(w->p1->id, w->p2->id);
+        mesh.ways.insert(std::move(handle));
+    }
+    mesh.graph.dirty = true;
+    mesh.nodes.at(to - 1) = std::move(n);
+}
+
+//节点块的中心，与buildNodeBlock相同：离平均位置最近的格子，距离相同时取x、y较小的
+inline ivec2 blockCenter(const std::vector<ivec2>& block) {
+    ivec2 sum(0, 0);
+    for (auto& p : block) {
+        sum += p;
+    }
+    double cx = (double)sum.x / block.size();
+    double cy = (double)sum.y / block.size();
+    ivec2 center = block[0];
+    double center_len = INFINITY;
+    for (auto& p : block) {
+        if (p.x == (int)cx && p.y == (int)cy) {
+            return p;
+        }
+        double dx = p.x - cx;
+        double dy = p.y - cy;
+        double len = dx * dx + dy * dy;
+        if (len < center_len || (len == center_len && (p.x < center.x || (p.x == center.x && p.y < center.y)))) {
+            center = p;
+            center_len = len;
+        }
+    }
+    return center;
+}
+
+//编辑把路网分成几块时，与removeWaste相同只保留最大的一块山脊，删掉的格子加入changed
+//先只沿路网从第一个节点搜索（与地图大小无关），有节点或山脊没走到时才标记整张图的连通域
+//返回false表示最大的一块是原来废弃的山脊，需要重建整张图的路网
+//路网没有分开时不检查废弃的山脊是否已经比路网更大
+inline bool keepLargestIsland(navmesh::navmesh& mesh, rect& changed) {
+    const int w = mesh.width;
+    const int h = mesh.height;
+    if (mesh.nodes.size() <= 1) {
+        return true;
+    }
+    size_t reached = 0;
+    {
+        ++mesh.searchMap_id;
+        std::queue<ivec2> que;
+        auto& begin = mesh.nodes[0]->position;
+        que.push(begin);
+        mesh.searchMap.at(begin.x, begin.y) = mesh.searchMap_id;
+        while (!que.empty()) {
+            auto pos = que.front();
+            que.pop();
+            int32_t id = mesh.idMap.at(pos.x, pos.y);
+            if (id > 0 && mesh.nodes[id - 1]->position == pos) {
+                ++reached;
+            }
+            for (int k = 0; k < 8; ++k) {
+                int x = pos.x + navmesh::neighborOffset[k][0];
+                int y = pos.y + navmesh::neighborOffset[k][1];
+                if (x >= 0 && y >= 0 && x < w && y < h &&
+                    mesh.searchMap.at(x, y) != mesh.searchMap_id) {
+                    int32_t nid = mesh.idMap.at(x, y);
+                    if (nid == -2 || nid > 0) {
+                        mesh.searchMap.at(x, y) = mesh.searchMap_id;
+                        que.push(ivec2(x, y));
+                    }
+                }
+            }
+        }
+    }
+    //没有节点的一段山脊被切断时也要删掉，它一定挨着变化过的格子
+    bool split = reached < mesh.nodes.size();
+    changed.expand(1, w, h).forEach([&](int x, int y) {
+        split |= mesh.idMap.at(x, y) == -2 && mesh.searchMap.at(x, y) != mesh.searchMap_id;
+    });
+    if (!split) {
+        return true;
+    }
+    //与removeWaste相同：所有山脊（包括废弃的）的连通域中取最大的一块
+    field<uint8_t> mask(w, h);
+#pragma omp parallel for
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            mask.at(x, y) = mesh.idMap.at(x, y) != 0;
+        }
+    }
+    field<int32_t> labels(w, h);
+    std::vector<ivec2> seeds;
+    int count = ccl::label(mask, labels, seeds);
+    std::vector<int64_t> sizes(count + 1, 0);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            ++sizes[labels.at(x, y)];
+        }
+    }
+    int32_t largest = 0;
+    for (int i = 1; i <= count; ++i) {
+        if (largest == 0 || sizes[i] > sizes[largest]) {
+            largest = i;
+        }
+    }
+    std::vector<uint8_t> keep(mesh.nodes.size(), 0);
+    bool any = false;
+    for (size_t i = 0; i < mesh.nodes.size(); ++i) {
+        auto& p = mesh.nodes[i]->position;
+        keep[i] = labels.at(p.x, p.y) == largest;
+        any |= keep[i];
+    }
+    if (!any) {
+        return false;
+    }
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            auto& id = mesh.idMap.at(x, y);
+            if ((id == -2 || id > 0) && labels.at(x, y) != largest) {
+                changed.add(ivec2(x, y));
+                if (id == -2) {
+                    id = -1;
+                }
+            }
+        }
+    }
+    navmesh::removeNodes(mesh, keep);  //节点块和路线由它删除
+    return true;
+}
+
+//在[origin, origin + (lw, lh))内按buildNavFlowField的代价重算上路流场
+//每走一步加上步长，走到的格子路宽不超过minPathWith时再加1000/路宽，
+//广搜的顺序依赖全图，局部改用Dijkstra；inside之外的格子只作为种子
+inline void localNavFlowField(navmesh::navmesh& mesh,
+                              const ivec2& origin,
+                              int lw,
+                              int lh,
+                              int32_t inside,
+                              const std::vector<std::pair<ivec2, double>>& seeds,
+                              double minPathWith) {
+    field<double> cost(lw, lh);
+    field<int32_t> from(lw, lh);
+    cost.setAll(INFINITY);
+    from.setAll(-1);
+    using item = std::pair<double, int>;
+    std::priority_queue<item, std::vector<item>, std::greater<item>> que;
+    for (auto& it : seeds) {
+        int index = it.first.y * lw + it.first.x;
+        if (it.second < cost.data[index]) {
+            cost.data[index] = it.second;
+            que.push(item(it.second, index));
+        }
+    }
+    while (!que.empty()) {
+        auto [c, index] = que.top();
+        que.pop();
+        if (c > cost.data[index]) {
+            continue;
+        }
+        int px = index % lw;
+        int py = index / lw;
+        for (int k = 0; k < 8; ++k) {
+            int nx = px + navmesh::neighborOffset[k][0];
+            int ny = py + navmesh::neighborOffset[k][1];
+            if (nx < 0 || ny < 0 || nx >= lw || ny >= lh ||
+                mesh.searchMap.at(nx + origin.x, ny + origin.y) != inside) {
+                continue;
+            }
+            double pathWidth = mesh.sdfMap.at(nx + origin.x, ny + origin.y);
+            if (pathWidth == 0) {
+                pathWidth = 0.000001;
+            }
+            double nc = c + ((k & 1) ? M_SQRT2 : 1.);
+            if (pathWidth <= minPathWith) {
+                nc += 1000. / pathWidth;  //太窄，逃离
+            }
+            int ni = ny * lw + nx;
+            if (nc < cost.data[ni]) {
+                cost.data[ni] = nc;
+                from.data[ni] = index;
+                que.push(item(nc, ni));
+            }
+        }
+    }
+    for (int y = 0; y < lh; ++y) {
+        for (int x = 0; x < lw; ++x) {
+            if (mesh.searchMap.at(x + origin.x, y + origin.y) != inside) {
+                continue;
+            }
+            int index = y * lw + x;
+            auto& res = mesh.pathNavMap.at(x + origin.x, y + origin.y);
+            if (cost.data[index] == 0) {
+                res = navmesh::pathNav(ivec2(-1, -1), 0);
+            } else if (from.data[index] < 0) {  //无法到达
+                res = navmesh::pathNav(ivec2(-1, -1), -1);
+            } else {
+                int f = from.data[index];
+                res = navmesh::pathNav(ivec2(f % lw, f / lw) + origin, cost.data[index]);
+            }
+        }
+    }
+}
+
+//重建[dirtyBegin, dirtyEnd]（闭区间，通常由updateSdfMap给出）附近的路网和上路流场
+//margin为流场重算范围在变化区域外多扩的格数，topSize与buildNodeBlock相同
+//变化区域外的流场只在经过变化区域时重算，不经过的保持原样（可能不是最优，但一定能走到路上）
+//流场按mesh.eikonalFlow选择与烘焙时相同的代价重算
+//atx为路线搜索用的网格，只按搜索范围增长，多次重新烘焙时可以复用
+inline bool rebakeRect(navmesh::navmesh& mesh,
+                       const ivec2& dirtyBegin,
+                       const ivec2& dirtyEnd,
+                       double minPathWith,
+                       astar_array::grid& atx,
+                       int margin = 8,
+                       int topSize = 2) {
+    const int w = mesh.width;
+    const int h = mesh.height;
+    const int nodeArea = 2;  //isNode的检查半径
+    if (mesh.compact) {
+        return false;
+    }
+    rect dirty;
+    dirty.add(dirtyBegin);
+    dirty.add(dirtyEnd);
+    dirty = dirty.expand(1, w, h);  //山脊检查用到相邻格子
+    if (dirty.empty()) {
+        return false;
+    }
+    rect changed = dirty;  //路网变化过的范围，用于确定流场的重算范围
+
+    //受影响的节点：块与isNode结果可能变化的范围相交
+    rect nodeRect = dirty.expand(nodeArea + topSize, w, h);
+    std::set<int32_t> removedNodes;
+    nodeRect.forEach([&](int x, int y) {
+        int32_t id = mesh.idMap.at(x, y);
+        if (id > 0) {
+            removedNodes.insert(id);
+        }
+    });
+    //受影响的路线：经过脏矩形，或者端点被删除（包围盒不相交的路线不用逐格检查）
+    for (auto it = mesh.ways.begin(); it != mesh.ways.end();) {
+        auto next = std::next(it);
+        auto& way = *it->second;
+        bool hit = removedNodes.count(it->first.first) || removedNodes.count(it->first.second);
+        if (!hit && dirty.meets(way.boxBegin, way.boxEnd)) {
+            for (size_t i = 0; !hit && i < way.maxPath.size(); ++i) {
+                hit = dirty.contains(way.maxPath[i].x, way.maxPath[i].y);
+            }
+        }
+        if (hit) {
+            removeWay(mesh, it, changed);
+        }
+        it = next;
+    }
+    //删除的节点的块还原为普通山脊
+    for (auto id : removedNodes) {
+        auto& n = mesh.nodes.at(id - 1);
+        floodId(mesh, n->position, id, [&](const ivec2& p) {
+            mesh.idMap.at(p.x, p.y) = -2;
+            changed.add(p);
+        });
+        auto& center = mesh.pathDisMap.at(n->position.x, n->position.y);
+        if (center.firstNode == id && center.secondNode == 0) {
+            center = navmesh::pathDis();
+        }
+        n.reset();
+    }
+
+    //重新检测脏矩形内的山脊
+    dirty.forEach([&](int x, int y) {
+        bool ridge = navmesh::isRidge(mesh, ivec2(x, y)) && mesh.sdfMap.at(x, y) > minPathWith;
+        mesh.idMap.at(x, y) = ridge ? -1 : 0;
+    });
+    //与removeWaste相同，只保留连到外面路网上的山脊（外面没有节点时保留最大的一块），
+    //外面原来被删除、现在连上的山脊一起恢复；断开的路网不会被删除
+    {
+        ++mesh.searchMap_id;
+        const int32_t mark = mesh.searchMap_id;
+        std::vector<std::vector<ivec2>> islands;
+        std::vector<uint8_t> connected;
+        const bool networkLeft = removedNodes.size() < mesh.nodes.size();
+        dirty.forEach([&](int x, int y) {
+            if (mesh.idMap.at(x, y) != -1 || mesh.searchMap.at(x, y) == mark) {
+                return;
+            }
+            std::vector<ivec2> island;
+            bool conn = false;
+            std::queue<ivec2> que;
+            que.push(ivec2(x, y));
+            mesh.searchMap.at(x, y) = mark;
+            while (!que.empty()) {
+                auto pos = que.front();
+                que.pop();
+                island.push_back(pos);
+                for (int k = 0; k < 8; ++k) {
+                    int nx = pos.x + navmesh::neighborOffset[k][0];
+                    int ny = pos.y + navmesh::neighborOffset[k][1];
+                    if (nx < 0 || ny < 0 || nx >= w || ny >= h) {
+                        continue;
+                    }
+                    int32_t id = mesh.idMap.at(nx, ny);
+                    if (!dirty.contains(nx, ny)) {
+                        conn |= id == -2 || id > 0;
+                    } else if (id == -1 && mesh.searchMap.at(nx, ny) != mark) {
+                        mesh.searchMap.at(nx, ny) = mark;
+                        que.push(ivec2(nx, ny));
+                    }
+                }
+            }
+            islands.push_back(std::move(island));
+            connected.push_back(conn);
+        });
+        size_t largest = 0;
+        for (size_t i = 1; i < islands.size(); ++i) {
+            if (islands[i].size() > islands[largest].size()) {
+                largest = i;
+            }
+        }
+        std::queue<ivec2> que;
+        for (size_t i = 0; i < islands.size(); ++i) {
+            if (networkLeft ? connected[i] : i == largest) {
+                for (auto& p : islands[i]) {
+                    mesh.idMap.at(p.x, p.y) = -2;
+                    que.push(p);
+                }
+            }
+        }
+        while (!que.empty()) {
+            auto pos = que.front();
+            que.pop();
+            for (int k = 0; k < 8; ++k) {
+                int nx = pos.x + navmesh::neighborOffset[k][0];
+                int ny = pos.y + navmesh::neighborOffset[k][1];
+                if (nx >= 0 && ny >= 0 && nx < w && ny < h && mesh.idMap.at(nx, ny) == -1) {
+                    mesh.idMap.at(nx, ny) = -2;
+                    changed.add(ivec2(nx, ny));
+                    que.push(ivec2(nx, ny));
+                }
+            }
+        }
+    }
+
+    //重新生成节点，范围包含删除的节点原来的块
+    rect blockRect = nodeRect;
+    blockRect.add(changed);
+    blockRect = blockRect.expand(0, w, h);
+    //isNode把所有山脊都当作-2，外面节点的块暂时还原
+    rect tmpRect = blockRect.expand(nodeArea, w, h);
+    std::vector<std::pair<ivec2, int32_t>> kept;
+    tmpRect.forEach([&](int x, int y) {
+        int32_t id = mesh.idMap.at(x, y);
+        if (id > 0) {
+            kept.emplace_back(ivec2(x, y), id);
+            mesh.idMap.at(x, y) = -2;
+        }
+    });
+    std::vector<ivec2> nodePixels;
+    blockRect.forEach([&](int x, int y) {
+        if (mesh.idMap.at(x, y) == -2 && navmesh::isNode(mesh, ivec2(x, y))) {
+            nodePixels.push_back(ivec2(x, y));
+        }
+    });
+    for (auto& it : kept) {
+        mesh.idMap.at(it.first.x, it.first.y) = it.second;
+    }
+    ++mesh.searchMap_id;
+    const int32_t blockMark = mesh.searchMap_id;
+    std::vector<ivec2> blockPoints;
+    for (auto& p : nodePixels) {
+        for (int i = -topSize; i <= topSize; ++i) {
+            for (int j = -topSize; j <= topSize; ++j) {
+                int x = i + p.x;
+                int y = j + p.y;
+                if (x >= 0 && y >= 0 && x < w && y < h &&
+                    mesh.idMap.at(x, y) == -2 &&
+                    mesh.searchMap.at(x, y) != blockMark) {
+                    mesh.searchMap.at(x, y) = blockMark;
+                    blockPoints.push_back(ivec2(x, y));
+                }
+            }
+        }
+    }
+    std::vector<int32_t> freeIds(removedNodes.begin(), removedNodes.end());
+    size_t freeUsed = 0;
+    {
+        ++mesh.searchMap_id;
+        const int32_t doneMark = mesh.searchMap_id;
+        for (auto& seed : blockPoints) {
+            if (mesh.searchMap.at(seed.x, seed.y) != blockMark) {
+                continue;  //已经分到某个块里
+            }
+            //八连通的块，顺便记录相邻的已有节点
+            std::vector<ivec2> block;
+            int32_t neighborId = 0;
+            std::queue<ivec2> que;
+            que.push(seed);
+            mesh.searchMap.at(seed.x, seed.y) = doneMark;
+            while (!que.empty()) {
+                auto pos = que.front();
+                que.pop();
+                block.push_back(pos);
+                for (int k = 0; k < 8; ++k) {
+                    int x = pos.x + navmesh::neighborOffset[k][0];
+                    int y = pos.y + navmesh::neighborOffset[k][1];
+                    if (x < 0 || y < 0 || x >= w || y >= h) {
+                        continue;
+                    }
+                    auto& m = mesh.searchMap.at(x, y);
+                    if (m == blockMark) {
+                        m = doneMark;
+                        que.push(ivec2(x, y));
+                    } else if (mesh.idMap.at(x, y) > 0 && neighborId == 0) {
+                        neighborId = mesh.idMap.at(x, y);
+                    }
+                }
+            }
+            //与已有的节点相邻时并入该节点（整图烘焙时它们是同一块）
+            int32_t id = neighborId;
+            if (id == 0) {
+                ivec2 center = blockCenter(block);
+                std::unique_ptr<navmesh::node> n(new navmesh::node);
+                if (freeUsed < freeIds.size()) {
+                    id = freeIds[freeUsed++];
+                    n->id = id;
+                    n->position = center;
+                    mesh.nodes.at(id - 1) = std::move(n);
+                } else {
+                    id = mesh.nodes.size() + 1;
+                    n->id = id;
+                    n->position = center;
+                    mesh.nodes.push_back(std::move(n));
+                }
+                mesh.pathDisMap.at(center.x, center.y) = navmesh::pathDis(id, 0, 0, 0);
+            }
+            for (auto& p : block) {
+                mesh.idMap.at(p.x, p.y) = id;
+                changed.add(p);
+            }
+            if (id == neighborId) {
+                //并入后整块的中心可能变化，与buildNodeBlock一样取合并后的中心
+                auto& n = mesh.nodes.at(id - 1);
+                std::vector<ivec2> whole;
+                floodId(mesh, n->position, id, [&](const ivec2& p) {
+                    whole.push_back(p);
+                });
+                ivec2 center = blockCenter(whole);
+                if (!(center == n->position)) {
+                    auto& old = mesh.pathDisMap.at(n->position.x, n->position.y);
+                    if (old.firstNode == id && old.secondNode == 0) {
+                        old = navmesh::pathDis();
+                    }
+                    changed.add(n->position);
+                    n->position = center;
+                    mesh.pathDisMap.at(center.x, center.y) = navmesh::pathDis(id, 0, 0, 0);
+                }
+            }
+        }
+    }
+    //没用完的id：把最后的节点移过来，保持id连续
+    for (size_t i = freeUsed; i < freeIds.size(); ++i) {
+        while (!mesh.nodes.empty() && !mesh.nodes.back()) {
+            mesh.nodes.pop_back();
+        }
+        int32_t hole = freeIds[i];
+        int32_t last = mesh.nodes.size();
+        if (hole < last) {
+            moveNode(mesh, last, hole);
+            mesh.nodes.pop_back();
+        }
+    }
+    while (!mesh.nodes.empty() && !mesh.nodes.back()) {
+        mesh.nodes.pop_back();
+    }
+
+    //重新连接：变化范围内的山脊所在的连通域，与buildConnect相同，恰好连两个节点时建立路线
+    {
+        ++mesh.searchMap_id;
+        const int32_t mark = mesh.searchMap_id;
+        rect seedRect = changed.expand(1, w, h);
+        std::vector<navmesh::wayCandidate> candidates;
+        std::vector<std::pair<int32_t, int32_t>> stale;
+        seedRect.forEach([&](int x, int y) {
+            if (mesh.idMap.at(x, y) != -2 || mesh.searchMap.at(x, y) == mark) {
+                return;
+            }
+            std::array<int, 3> ids{0, 0, 0};
+            int n = 0;
+            std::queue<ivec2> que;
+            que.push(ivec2(x, y));
+            mesh.searchMap.at(x, y) = mark;
+            while (!que.empty()) {
+                auto pos = que.front();
+                que.pop();
+                //连通域里原有的路线要重建
+                auto& d = mesh.pathDisMap.at(pos.x, pos.y);
+                if (d.secondNode > 0) {
+                    stale.emplace_back(std::min(d.firstNode, d.secondNode),
+                                       std::max(d.firstNode, d.secondNode));
+                }
+                for (int k = 0; k < 8; ++k) {
+                    int nx = pos.x + navmesh::neighborOffset[k][0];
+                    int ny = pos.y + navmesh::neighborOffset[k][1];
+                    if (nx < 0 || ny < 0 || nx >= w || ny >= h) {
+                        continue;
+                    }
+                    int32_t id = mesh.idMap.at(nx, ny);
+                    if (id == -2) {
+                        if (mesh.searchMap.at(nx, ny) != mark) {
+                            mesh.searchMap.at(nx, ny) = mark;
+                            que.push(ivec2(nx, ny));
+                        }
+                    } else if (id > 0 && n < 3 &&
+                               std::find(ids.begin(), ids.begin() + n, id) == ids.begin() + n) {
+                        ids[n++] = id;
+                    }
+                }
+            }
+            if (n == 2) {
+                navmesh::wayCandidate way_c;
+                way_c.begin_id = std::min(ids[0], ids[1]);
+                way_c.target_id = std::max(ids[0], ids[1]);
+                way_c.begin = mesh.nodes.at(way_c.begin_id - 1)->position;
+                way_c.target = mesh.nodes.at(way_c.target_id - 1)->position;
+                candidates.push_back(std::move(way_c));
+            }
+        });
+        for (auto& key : stale) {
+            auto it = mesh.ways.find(key);
+            if (it != mesh.ways.end()) {
+                removeWay(mesh, it, changed);
+            }
+        }
+        if (!candidates.empty()) {
+            for (auto& way_c : candidates) {  //搜索范围为空，findPath用searchArea求出
+                if (navmesh::findPath(mesh, way_c, atx)) {
+                    navmesh::commitPath(mesh, way_c);
+                    for (auto& point : way_c.path) {
+                        changed.add(std::get<0>(point));
+                    }
+                }
+            }
+        }
+    }
+
+    if (!keepLargestIsland(mesh, changed)) {
+        return rebakeRect(mesh, ivec2(0, 0), ivec2(w - 1, h - 1), minPathWith, atx, margin, topSize);
+    }
+    navmesh::buildAdjacency(mesh);
+
+    //流场：变化范围外扩margin，再加上所有沿流场会走进这个范围的格子
+    rect flowRect = changed.expand(margin, w, h);
+    ++mesh.searchMap_id;
+    const int32_t inside = mesh.searchMap_id;
+    rect localRect;
+    {
+        std::queue<ivec2> que;
+        flowRect.forEach([&](int x, int y) {
+            mesh.searchMap.at(x, y) = inside;
+            que.push(ivec2(x, y));
+        });
+        localRect = flowRect;
+        while (!que.empty()) {
+            auto pos = que.front();
+            que.pop();
+            for (int k = 0; k < 8; ++k) {
+                int x = pos.x + navmesh::neighborOffset[k][0];
+                int y = pos.y + navmesh::neighborOffset[k][1];
+                if (x >= 0 && y >= 0 && x < w && y < h &&
+                    mesh.searchMap.at(x, y) != inside &&
+                    mesh.pathNavMap.at(x, y).target == pos) {
+                    mesh.searchMap.at(x, y) = inside;
+                    localRect.add(ivec2(x, y));
+                    que.push(ivec2(x, y));
+                }
+            }
+        }
+    }
+    //在包围盒（外扩一格）里求解，范围外的格子以原来的cost作为种子，不可通过
+    localRect = localRect.expand(1, w, h);
+    const int lw = localRect.end.x - localRect.begin.x + 1;
+    const int lh = localRect.end.y - localRect.begin.y + 1;
+    const ivec2 origin = localRect.begin;
+    std::vector<std::pair<ivec2, double>> seeds;
+    localRect.forEach([&](int x, int y) {
+        if (mesh.searchMap.at(x, y) == inside) {
+            return;
+        }
+        double cost = mesh.pathNavMap.at(x, y).cost;
+        if (cost >= 0) {
+            seeds.emplace_back(ivec2(x, y) - origin, cost);
+        }
+    });
+    auto addRoad = [&](const ivec2& p) {
+        if (localRect.contains(p.x, p.y) && mesh.searchMap.at(p.x, p.y) == inside) {
+            seeds.emplace_back(p - origin, 0.);
+        }
+    };
+    for (auto& it : mesh.ways) {
+        if (localRect.meets(it.second->boxBegin, it.second->boxEnd)) {
+            for (auto& p : it.second->maxPath) {
+                addRoad(p);
+            }
+        }
+    }
+    for (auto& it : mesh.nodes) {
+        addRoad(it->position);
+    }
+    if (!mesh.eikonalFlow) {
+        localNavFlowField(mesh, origin, lw, lh, inside, seeds, minPathWith);
+        return true;
+    }
+    field<double> slowness(lw, lh);
+    localRect.forEach([&](int x, int y) {
+        int index = (y - origin.y) * lw + (x - origin.x);
+        slowness.data[index] = mesh.searchMap.at(x, y) == inside
+                                   ? navmesh::navSlowness(mesh, x, y, minPathWith)
+                                   : INFINITY;
+    });
+    field<double> time(lw, lh);
+    eikonal::march(time, slowness, seeds);
+    localRect.forEach([&](int x, int y) {
+        if (mesh.searchMap.at(x, y) != inside) {
+            return;
+        }
+        double t = time.data[(y - origin.y) * lw + (x - origin.x)];
+        auto& res = mesh.pathNavMap.at(x, y);
+        if (t == 0) {
+            res = navmesh::pathNav(ivec2(-1, -1), 0);
+            return;
+        }
+        ivec2 next = navmesh::steepestDescent(x - origin.x, y - origin.y, lw, lh, t, [&](int nx, int ny) {
+            return time.data[ny * lw + nx];
+        });
+        if (next.x < 0) {  //无法到达
+            res = navmesh::pathNav(ivec2(-1, -1), -1);
+        } else {
+            res = navmesh::pathNav(next + origin, t);
+        }
+    });
+    return true;
+}
+inline bool rebakeRect(navmesh::navmesh& mesh,
+                       const ivec2& dirtyBegin,
+                       const ivec2& dirtyEnd,
+                       double minPathWith,
+                       int margin = 8,
+                       int topSize = 2) {
+    astar_array::grid atx;
+    return rebakeRect(mesh, dirtyBegin, dirtyEnd, minPathWith, atx, margin, topSize);
+}
+
+//障碍点变化后的完整更新：局部更新sdf再局部重建，tree必须已经插入added并删除removed
+inline bool update(navmesh::navmesh& mesh,
+                   const KDTree& tree,
+                   const std::vector<vec2>& added,
+                   const std::vector<vec2>& removed,
+                   double minPathWith) {
+    ivec2 dirtyBegin, dirtyEnd;
+    if (mesh.compact || !navmesh::updateSdfMap(mesh, tree, added, removed, dirtyBegin, dirtyEnd)) {
+        return false;
+    }
+    return rebakeRect(mesh, dirtyBegin, dirtyEnd, minPathWith);
+}
+
+}  // namespace sdpf::rebake
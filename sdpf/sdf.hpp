@@ -1,23 +1,188 @@
 #pragma once
 #include <math.h>
 #include <omp.h>
+#include <stdint.h>
+#include <algorithm>
 #include <cmath>
+#include <memory>
 #include <queue>
 #include <set>
 #include <stdexcept>
 #include <tuple>
 #include <vector>
+#if defined(__GNUC__) && defined(__SSE2__)
+//AVX2的内核用target属性单独编译，运行时检测CPU后选择，不需要-mavx2
+#include <immintrin.h>
+#define SDPF_SDF_X86_SIMD 1
+#endif
 #include "field.hpp"
 #include "vec2.hpp"
 //sdf（有向距离场）
 namespace sdpf::sdf {
 
+//最小值金字塔
+//第k层的格子i覆盖像素[i*2^k, (i+1)*2^k]（闭区间，两个方向相同），值为其中sdf的最小值
+//格子内任意位置的双线性插值都不小于它，可作为保守的距离下界
+struct pyramid {
+    std::vector<field<double>> levels{};
+
+    template <class getter_c>
+    inline void build(int width, int height, const getter_c& get) {
+        levels.clear();
+        if (width <= 0 || height <= 0) {
+            return;
+        }
+        //第0层：相邻2x2像素的最小值
+        levels.emplace_back(width, height);
+        auto& base = levels.back();
+#pragma omp parallel for
+        for (int j = 0; j < height; ++j) {
+            int j2 = std::min(j + 1, height - 1);
+            for (int i = 0; i < width; ++i) {
+                int i2 = std::min(i + 1, width - 1);
+                base.data[j * width + i] = std::min(std::min(get(i, j), get(i2, j)),
+                                                    std::min(get(i, j2), get(i2, j2)));
+            }
+        }
+        //逐层合并2x2个格子，直到只剩一个格子
+        while (levels.back().width > 1 || levels.back().height > 1) {
+            int pw = levels.back().width;
+            int ph = levels.back().height;
+            int w = (pw + 1) / 2;
+            int h = (ph + 1) / 2;
+            levels.emplace_back(w, h);
+            const double* src = levels[levels.size() - 2].data;
+            double* dst = levels.back().data;
+#pragma omp parallel for
+            for (int j = 0; j < h; ++j) {
+                int j1 = 2 * j;
+                int j2 = std::min(j1 + 1, ph - 1);
+                for (int i = 0; i < w; ++i) {
+                    int i1 = 2 * i;
+                    int i2 = std::min(i1 + 1, pw - 1);
+                    dst[j * w + i] = std::min(std::min(src[j1 * pw + i1], src[j1 * pw + i2]),
+                                              std::min(src[j2 * pw + i1], src[j2 * pw + i2]));
+                }
+            }
+        }
+    }
+
+    //像素[x0,x1]*[y0,y1]（闭区间）的值变化后，只重算覆盖它们的格子
+    template <class getter_c>
+    inline void update(int x0, int y0, int x1, int y1, const getter_c& get) {
+        if (levels.empty()) {
+            return;
+        }
+        const int width = levels[0].width;
+        const int height = levels[0].height;
+        //第0层的格子i覆盖像素i和i+1
+        x0 = std::max(x0 - 1, 0);
+        y0 = std::max(y0 - 1, 0);
+        x1 = std::min(x1, width - 1);
+        y1 = std::min(y1, height - 1);
+        if (x1 < x0 || y1 < y0) {
+            return;
+        }
+        auto& base = levels[0];
+        for (int j = y0; j <= y1; ++j) {
+            int j2 = std::min(j + 1, height - 1);
+            for (int i = x0; i <= x1; ++i) {
+                int i2 = std::min(i + 1, width - 1);
+                base.data[j * width + i] = std::min(std::min(get(i, j), get(i2, j)),
+                                                    std::min(get(i, j2), get(i2, j2)));
+            }
+        }
+        for (size_t k = 1; k < levels.size(); ++k) {
+            int pw = levels[k - 1].width;
+            int ph = levels[k - 1].height;
+            int w = levels[k].width;
+            const double* src = levels[k - 1].data;
+            double* dst = levels[k].data;
+            x0 >>= 1;
+            y0 >>= 1;
+            x1 >>= 1;
+            y1 >>= 1;
+            for (int j = y0; j <= y1; ++j) {
+                int j1 = 2 * j;
+                int j2 = std::min(j1 + 1, ph - 1);
+                for (int i = x0; i <= x1; ++i) {
+                    int i1 = 2 * i;
+                    int i2 = std::min(i1 + 1, pw - 1);
+                    dst[j * w + i] = std::min(std::min(src[j1 * pw + i1], src[j1 * pw + i2]),
+                                              std::min(src[j2 * pw + i1], src[j2 * pw + i2]));
+                }
+            }
+        }
+    }
+
+    //像素坐标矩形[x0,x1]*[y0,y1]内sdf的下界，矩形需在地图内
+    inline double minInRect(double x0, double y0, double x1, double y1) const {
+        //选取格子不小于矩形的层，最多覆盖2x2个格子
+        double extent = std::max(x1 - x0, y1 - y0);
+        int k = 0;
+        while (k + 1 < (int)levels.size() && (1 << k) < extent) {
+            ++k;
+        }
+        auto& l = levels[k];
+        int ix0 = std::clamp((int)x0 >> k, 0, l.width - 1);
+        int ix1 = std::clamp((int)x1 >> k, 0, l.width - 1);
+        int iy0 = std::clamp((int)y0 >> k, 0, l.height - 1);
+        int iy1 = std::clamp((int)y1 >> k, 0, l.height - 1);
+        double res = INFINITY;
+        for (int y = iy0; y <= iy1; ++y) {
+            for (int x = ix0; x <= ix1; ++x) {
+                res = std::min(res, l.data[y * l.width + x]);
+            }
+        }
+        return res;
+    }
+};
+
 struct sdf : field<double> {  //运行阶段为只读数据结构
     inline sdf(int w, int h)
         : field(w, h) {}
     double* data = nullptr;
     double scale = 1.0;  //缩放（sdf有缩放不失真的特性）
 
+    //16位定点数存储，压缩后double数据被释放，只能通过value读取
+    std::unique_ptr<field<uint16_t>> packed;
+    double packedStep = 0;  //定点数的精度
+
+    std::unique_ptr<pyramid> minPyramid;  //最小值金字塔，buildPyramid后可用
+
+    inline double value(int x, int y) {
+        if (packed) {
+            return packed->at(x, y) * packedStep;
+        }
+        return at(x, y);
+    }
+    //转换为16位定点数，step为精度，超出范围的值截断到最大值
+    inline void pack(double step) {
+        auto q = std::make_unique<field<uint16_t>>(width, height);
+        const double* src = field<double>::data;
+        int len = width * height;
+        for (int i = 0; i < len; ++i) {
+            double v = round(src[i] / step);
+            q->data[i] = (uint16_t)std::clamp(v, 0., 65535.);
+        }
+        delete[] field<double>::data;
+        field<double>::data = nullptr;
+        packed = std::move(q);
+        packedStep = step;
+        if (minPyramid) {
+            buildPyramid();  //取整后的值可能比原来小
+        }
+    }
+    //直接创建w*h的定点数存储（用于加载），不分配double数据
+    inline void resetPacked(int w, int h, double step) {
+        delete[] field<double>::data;
+        field<double>::data = nullptr;
+        width = w;
+        height = h;
+        packed = std::make_unique<field<uint16_t>>(w, h);
+        packedStep = step;
+    }
+
     constexpr double operator()(double x, double y) {  //查找（自带插值）
         return getInterpBilinear(x * scale, y * scale) * scale;
     }
@@ -51,11 +216,11 @@ struct sdf : field<double> {  //运行阶段为只读数据结构
             {
                 //如果差值点在图像的最右下角
                 if (fabs(y - height + 1) <= epsilon) {
-                    f1 = at(x1, y1);
+                    f1 = value(x1, y1);
                     return f1;
                 } else {
-                    f1 = at(x1, y1);
-                    f3 = at(x1, y2);
+                    f1 = value(x1, y1);
+                    f3 = value(x1, y2);
 
                     //图像右方的插值
                     return ((f1 + (y - y1) * (f3 - f1)));
@@ -63,17 +228,17 @@ struct sdf : field<double> {  //运行阶段为只读数据结构
             }
             //如果插入点在图像的下方
             else if (fabs(y - height + 1) <= epsilon) {
-                f1 = at(x1, y1);
-                f2 = at(x2, y1);
+                f1 = value(x1, y1);
+                f2 = value(x2, y1);
 
                 //图像下方的插值
                 return ((f1 + (x - x1) * (f2 - f1)));
             } else {
                 //得计算四个临近点像素值
-                f1 = at(x1, y1);
-                f2 = at(x2, y1);
-                f3 = at(x1, y2);
-                f4 = at(x2, y2);
+                f1 = value(x1, y1);
+                f2 = value(x2, y1);
+                f3 = value(x1, y2);
+                f4 = value(x2, y2);
 
                 //第一次插值
                 f12 = f1 + (x - x1) * (f2 - f1);  //f(x,0)
@@ -86,15 +251,174 @@ struct sdf : field<double> {  //运行阶段为只读数据结构
             }
         }
     }
+    //批量查找，结果与逐个调用operator[]相同
+    //内部的点不做边界检查并用SIMD插值，靠近边缘和地图外的点走标量路径
+    //x86上按CPU选择AVX2或SSE2的内核
+    inline void sample(const vec2* pos, int count, double* out) {
+        int i = 0;
+        if (packed) {
+            //定点数存储逐个解码
+            for (; i < count; ++i) {
+                out[i] = getInterpBilinear(pos[i].x * scale, pos[i].y * scale) * scale;
+            }
+            return;
+        }
+#if defined(SDPF_SDF_X86_SIMD)
+        static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+        i = hasAVX2 ? sampleAVX2(pos, count, out) : sampleSSE2(pos, count, out);
+#endif
+        //剩余的点
+        const double* base = field<double>::data;
+        const double epsilon = 0.0001;
+        const double xmax = width - 1 - epsilon;
+        const double ymax = height - 1 - epsilon;
+        for (; i < count; ++i) {
+            double x = pos[i].x * scale;
+            double y = pos[i].y * scale;
+            if (x >= 0 && x < xmax && y >= 0 && y < ymax) {
+                int x1 = (int)x;
+                int y1 = (int)y;
+                const double* p = base + y1 * width + x1;
+                double f12 = p[0] + (x - x1) * (p[1] - p[0]);
+                double f34 = p[width] + (x - x1) * (p[width + 1] - p[width]);
+                out[i] = (f12 + (y - y1) * (f34 - f12)) * scale;
+            } else {
+                out[i] = getInterpBilinear(x, y) * scale;
+            }
+        }
+    }
+#if defined(SDPF_SDF_X86_SIMD)
+    //sample的SIMD内核，每次处理4个（AVX2）或2个（SSE2）点，返回处理完的点数，剩下的由sample逐个处理
+    //只能用于double存储；调用sampleAVX2前必须确认CPU支持AVX2
+    __attribute__((target("avx2"))) inline int sampleAVX2(const vec2* pos, int count, double* out) {
+        const double* base = field<double>::data;
+        const double epsilon = 0.0001;
+        const __m256d vscale = _mm256_set1_pd(scale);
+        const __m256d vzero = _mm256_setzero_pd();
+        const __m256d vxmax = _mm256_set1_pd(width - 1 - epsilon);
+        const __m256d vymax = _mm256_set1_pd(height - 1 - epsilon);
+        const __m128i vwidth = _mm_set1_epi32(width);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            //(x0,y0,x1,y1),(x2,y2,x3,y3) -> (x0,x1,x2,x3),(y0,y1,y2,y3)
+            __m256d a = _mm256_loadu_pd(&pos[i].x);
+            __m256d b = _mm256_loadu_pd(&pos[i + 2].x);
+            __m256d x = _mm256_permute4x64_pd(_mm256_unpacklo_pd(a, b), 0xD8);
+            __m256d y = _mm256_permute4x64_pd(_mm256_unpackhi_pd(a, b), 0xD8);
+            x = _mm256_mul_pd(x, vscale);
+            y = _mm256_mul_pd(y, vscale);
+            __m256d inside = _mm256_and_pd(
+                _mm256_and_pd(_mm256_cmp_pd(x, vzero, _CMP_GE_OQ), _mm256_cmp_pd(x, vxmax, _CMP_LT_OQ)),
+                _mm256_and_pd(_mm256_cmp_pd(y, vzero, _CMP_GE_OQ), _mm256_cmp_pd(y, vymax, _CMP_LT_OQ)));
+            if (_mm256_movemask_pd(inside) != 0xF) {
+                for (int k = i; k < i + 4; ++k) {
+                    out[k] = getInterpBilinear(pos[k].x * scale, pos[k].y * scale) * scale;
+                }
+                continue;
+            }
+            __m128i x1 = _mm256_cvttpd_epi32(x);
+            __m128i y1 = _mm256_cvttpd_epi32(y);
+            __m128i id = _mm_add_epi32(_mm_mullo_epi32(y1, vwidth), x1);
+            __m256d f1 = _mm256_mask_i32gather_pd(vzero, base, id, inside, 8);
+            __m256d f2 = _mm256_mask_i32gather_pd(vzero, base + 1, id, inside, 8);
+            __m256d f3 = _mm256_mask_i32gather_pd(vzero, base + width, id, inside, 8);
+            __m256d f4 = _mm256_mask_i32gather_pd(vzero, base + width + 1, id, inside, 8);
+            __m256d dx = _mm256_sub_pd(x, _mm256_cvtepi32_pd(x1));
+            __m256d dy = _mm256_sub_pd(y, _mm256_cvtepi32_pd(y1));
+            __m256d f12 = _mm256_add_pd(f1, _mm256_mul_pd(dx, _mm256_sub_pd(f2, f1)));
+            __m256d f34 = _mm256_add_pd(f3, _mm256_mul_pd(dx, _mm256_sub_pd(f4, f3)));
+            __m256d res = _mm256_add_pd(f12, _mm256_mul_pd(dy, _mm256_sub_pd(f34, f12)));
+            _mm256_storeu_pd(out + i, _mm256_mul_pd(res, vscale));
+        }
+        return i;
+    }
+    inline int sampleSSE2(const vec2* pos, int count, double* out) {
+        const double* base = field<double>::data;
+        const double epsilon = 0.0001;
+        const __m128d vscale = _mm_set1_pd(scale);
+        const __m128d vzero = _mm_setzero_pd();
+        const __m128d vxmax = _mm_set1_pd(width - 1 - epsilon);
+        const __m128d vymax = _mm_set1_pd(height - 1 - epsilon);
+        int i = 0;
+        for (; i + 2 <= count; i += 2) {
+            __m128d a = _mm_loadu_pd(&pos[i].x);
+            __m128d b = _mm_loadu_pd(&pos[i + 1].x);
+            __m128d x = _mm_mul_pd(_mm_unpacklo_pd(a, b), vscale);
+            __m128d y = _mm_mul_pd(_mm_unpackhi_pd(a, b), vscale);
+            __m128d inside = _mm_and_pd(
+                _mm_and_pd(_mm_cmpge_pd(x, vzero), _mm_cmplt_pd(x, vxmax)),
+                _mm_and_pd(_mm_cmpge_pd(y, vzero), _mm_cmplt_pd(y, vymax)));
+            if (_mm_movemask_pd(inside) != 0x3) {
+                for (int k = i; k < i + 2; ++k) {
+                    out[k] = getInterpBilinear(pos[k].x * scale, pos[k].y * scale) * scale;
+                }
+                continue;
+            }
+            __m128i x1 = _mm_cvttpd_epi32(x);
+            __m128i y1 = _mm_cvttpd_epi32(y);
+            //SSE2没有gather，每个点的上下两行各读两个相邻的值
+            const double* pa = base + _mm_cvtsi128_si32(y1) * width + _mm_cvtsi128_si32(x1);
+            const double* pb = base + _mm_cvtsi128_si32(_mm_srli_si128(y1, 4)) * width +
+                               _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+            __m128d a0 = _mm_loadu_pd(pa);
+            __m128d a1 = _mm_loadu_pd(pa + width);
+            __m128d b0 = _mm_loadu_pd(pb);
+            __m128d b1 = _mm_loadu_pd(pb + width);
+            __m128d f1 = _mm_unpacklo_pd(a0, b0);
+            __m128d f2 = _mm_unpackhi_pd(a0, b0);
+            __m128d f3 = _mm_unpacklo_pd(a1, b1);
+            __m128d f4 = _mm_unpackhi_pd(a1, b1);
+            __m128d dx = _mm_sub_pd(x, _mm_cvtepi32_pd(x1));
+            __m128d dy = _mm_sub_pd(y, _mm_cvtepi32_pd(y1));
+            __m128d f12 = _mm_add_pd(f1, _mm_mul_pd(dx, _mm_sub_pd(f2, f1)));
+            __m128d f34 = _mm_add_pd(f3, _mm_mul_pd(dx, _mm_sub_pd(f4, f3)));
+            __m128d res = _mm_add_pd(f12, _mm_mul_pd(dy, _mm_sub_pd(f34, f12)));
+            _mm_storeu_pd(out + i, _mm_mul_pd(res, vscale));
+        }
+        return i;
+    }
+#endif
+    //构建最小值金字塔，sdf修改后需要重新构建或调用updatePyramid
+    inline void buildPyramid() {
+        minPyramid = std::make_unique<pyramid>();
+        minPyramid->build(width, height, [this](int x, int y) { return value(x, y); });
+    }
+    //像素矩形[x0,x1]*[y0,y1]（闭区间）的sdf修改后更新金字塔，没有金字塔时什么也不做
+    inline void updatePyramid(int x0, int y0, int x1, int y1) {
+        if (minPyramid) {
+            minPyramid->update(x0, y0, x1, y1, [this](int x, int y) { return value(x, y); });
+        }
+    }
+
+    //矩形区域[lo,hi]内距离的下界（世界坐标），有金字塔时为O(1)
+    //超出地图的部分视为障碍物，返回0
+    inline double minInBox(const vec2& lo, const vec2& hi) {
+        double x0 = lo.x * scale, y0 = lo.y * scale;
+        double x1 = hi.x * scale, y1 = hi.y * scale;
+        if (x0 < 0 || y0 < 0 || x1 > width - 1 || y1 > height - 1) {
+            return 0;
+        }
+        if (minPyramid) {
+            return minPyramid->minInRect(x0, y0, x1, y1) * scale;
+        }
+        double res = INFINITY;
+        for (int y = (int)y0; y <= std::min((int)y1 + 1, height - 1); ++y) {
+            for (int x = (int)x0; x <= std::min((int)x1 + 1, width - 1); ++x) {
+                res = std::min(res, value(x, y));
+            }
+        }
+        return res * scale;
+    }
+
     //通过三个点获取法线
     inline vec2 getDir(const ivec2& p1, const ivec2& p2, const ivec2& p3) {
-        double p1_z = at(p1.x, p1.y);
+        double p1_z = value(p1.x, p1.y);
         double x1 = p2.x - p1.x;
         double y1 = p2.y - p1.y;
-        double z1 = at(p2.x, p2.y) - p1_z;
+        double z1 = value(p2.x, p2.y) - p1_z;
         double x2 = p3.x - p1.x;
         double y2 = p3.y - p1.y;
-        double z2 = at(p3.x, p3.y) - p1_z;
+        double z2 = value(p3.x, p3.y) - p1_z;
         double x0 = y1 * z2 - y2 * z1;
         double y0 = x1 * z2 - x2 * z1;
         double z0 = x1 * y2 - x2 * y1;
@@ -0,0 +1,137 @@
+#pragma once
+#include <omp.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "field.hpp"
+//按距离排序、保持拓扑的细化（骨架化）
+//前景为8连通，按order从小到大分层删除简单点，连通性和孔洞数不变
+//结果为一个像素宽的骨架，只在四条分支交汇处可能留下删任何一格都会改变拓扑的2x2块
+//同一层内分四个子场（x、y的奇偶）并行删除，同一子场的格子互不相邻，与逐个删除的结果等价
+namespace sdpf::thinning {
+
+//8邻域，从右边开始逆时针：右、右上、上、左上、左、左下、下、右下
+inline constexpr int ringOffset[8][2] = {
+    {1, 0}, {1, -1}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+
+//8连通的Yokoi连接数，为1时删除该点不改变拓扑（简单点）
+inline int connectivity(const uint8_t* n) {
+    int res = 0;
+    for (int k = 0; k < 8; k += 2) {
+        int a = !n[k];
+        int b = !n[(k + 1) & 7];
+        int c = !n[(k + 2) & 7];
+        res += a - a * b * c;
+    }
+    return res;
+}
+
+//mask：前景非0，原地细化，地图边缘的格子视为背景的邻居
+//order：删除顺序（通常为sdf），按floor(order / step)分层，层内并行
+//anchor：非0的格子成为端点后保留，用来留住分支（否则没有孔的区域会缩成一个点）
+inline void thin(field<uint8_t>& mask,
+                 const double* order,
+                 const field<uint8_t>& anchor,
+                 double step = 1.) {
+    const int w = mask.width;
+    const int h = mask.height;
+    uint8_t* m = mask.data;
+    const uint8_t* a = anchor.data;
+
+    //按层计数排序
+    int maxLevel = 0;
+    std::vector<int32_t> level(w * h, -1);
+#pragma omp parallel for reduction(max : maxLevel)
+    for (int i = 0; i < w * h; ++i) {
+        if (m[i]) {
+            int l = std::max(0, (int)floor(order[i] / step));
+            level[i] = l;
+            maxLevel = std::max(maxLevel, l);
+        }
+    }
+    std::vector<int32_t> offsets(maxLevel + 2, 0);
+    for (int i = 0; i < w * h; ++i) {
+        if (level[i] >= 0) {
+            ++offsets[level[i] + 1];
+        }
+    }
+    for (int l = 0; l <= maxLevel; ++l) {
+        offsets[l + 1] += offsets[l];
+    }
+    std::vector<int32_t> sorted(offsets[maxLevel + 1]);
+    {
+        std::vector<int32_t> pos(offsets.begin(), offsets.end() - 1);
+        for (int i = 0; i < w * h; ++i) {
+            if (level[i] >= 0) {
+                sorted[pos[level[i]]++] = i;
+            }
+        }
+    }
+
+    auto deletable = [&](int32_t index) {
+        int x = index % w;
+        int y = index / w;
+        uint8_t n[8];
+        int count = 0;
+        for (int k = 0; k < 8; ++k) {
+            int nx = x + ringOffset[k][0];
+            int ny = y + ringOffset[k][1];
+            n[k] = nx >= 0 && ny >= 0 && nx < w && ny < h && m[ny * w + nx];
+            count += n[k];
+        }
+        if (count == 1 && a[index]) {
+            return false;  //分支的端点
+        }
+        return connectivity(n) == 1;
+    };
+
+    //当前层及以前留下的格子，每层反复删除直到不再变化
+    //检查过不能删的格子，只有相邻的格子被删后才需要再检查
+    std::vector<uint8_t> dirty(w * h, 1);
+    std::vector<int32_t> active;
+    std::vector<uint8_t> flags;
+    for (int l = 0; l <= maxLevel; ++l) {
+        active.insert(active.end(), sorted.begin() + offsets[l], sorted.begin() + offsets[l + 1]);
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            const int active_len = active.size();
+            flags.assign(active_len, 0);
+            for (int sub = 0; sub < 4; ++sub) {
+#pragma omp parallel for
+                for (int i = 0; i < active_len; ++i) {
+                    int32_t index = active[i];
+                    int x = index % w;
+                    int y = index / w;
+                    if (((x & 1) | ((y & 1) << 1)) == sub && dirty[index] && m[index]) {
+                        dirty[index] = 0;
+                        flags[i] = deletable(index);
+                    }
+                }
+                for (int i = 0; i < active_len; ++i) {
+                    int32_t index = active[i];
+                    if (flags[i] && m[index]) {
+                        m[index] = 0;
+                        changed = true;
+                        int x = index % w;
+                        int y = index / w;
+                        for (int k = 0; k < 8; ++k) {
+                            int nx = x + ringOffset[k][0];
+                            int ny = y + ringOffset[k][1];
+                            if (nx >= 0 && ny >= 0 && nx < w && ny < h) {
+                                dirty[ny * w + nx] = 1;
+                            }
+                        }
+                    }
+                }
+            }
+            //删掉的格子不再检查
+            active.erase(std::remove_if(active.begin(), active.end(),
+                                        [&](int32_t index) { return !m[index]; }),
+                         active.end());
+        }
+    }
+}
+
+}  // namespace sdpf::thinning
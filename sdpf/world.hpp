@@ -0,0 +1,852 @@
+#pragma once
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "bake.hpp"
+#include "loader.hpp"
+#include "navmesh.hpp"
+//分块世界
+//世界按tileSize切成若干块，每块向外扩margin单独烘焙，块的边界在离核心区margin远的地方，
+//所以核心区里离障碍物不超过margin的地方与整图烘焙一致（更空旷的地方山脊可能偏移）
+//块内的路线在核心区的边界处切断，切点为传送点（portal），相邻块同一条边上的传送点按距离一对一相连，
+//各块由此拼成一张图；块按需从磁盘加载，超过maxTiles时淘汰最久没用过的块
+namespace sdpf::world {
+
+struct tileKey {
+    int x = 0;
+    int y = 0;
+    inline bool operator<(const tileKey& o) const {
+        return x < o.x || (x == o.x && y < o.y);
+    }
+    inline bool operator==(const tileKey& o) const {
+        return x == o.x && y == o.y;
+    }
+};
+
+//传送点所在的边
+enum side : int {
+    sideNone = -1,
+    sideLeft = 0,
+    sideRight = 1,
+    sideTop = 2,
+    sideBottom = 3,
+};
+inline int oppositeSide(int s) {
+    return s ^ 1;
+}
+
+struct vertex {
+    ivec2 position;                //世界坐标
+    int32_t nodeId = 0;            //块内navmesh的节点id，传送点为0
+    int side = sideNone;           //传送点所在的边
+    int32_t partner = -1;          //相邻块中与传送点相连的传送点，由matchSide填写
+    std::vector<int32_t> edges{};  //相连的边
+};
+
+//路线在核心区内的一段
+struct edge {
+    int32_t v1 = 0, v2 = 0;  //两端的顶点，v1在begin一端
+    double length = 0;
+    double minWidth = 0;
+    std::pair<int32_t, int32_t> way{};  //所属路线
+    int32_t begin = 0, end = 0;         //在路线maxPath中的下标范围[begin, end]
+};
+
+struct tile {
+    tileKey key;
+    ivec2 origin;     //navmesh的(0,0)对应的世界坐标
+    ivec2 coreBegin;  //核心区[coreBegin, coreEnd)，世界坐标
+    ivec2 coreEnd;
+    std::unique_ptr<navmesh::navmesh> mesh;
+    std::vector<vertex> vertices{};
+    std::vector<edge> edges{};
+    bool sideMatched[4] = {false, false, false, false};  //各边的传送点是否已经与相邻块配对
+
+    inline bool inCore(const ivec2& p) const {  //p为世界坐标
+        return p.x >= coreBegin.x && p.y >= coreBegin.y && p.x < coreEnd.x && p.y < coreEnd.y;
+    }
+    //核心区外的点在哪条边外
+    inline int sideOf(const ivec2& p) const {
+        if (p.x < coreBegin.x) {
+            return sideLeft;
+        }
+        if (p.x >= coreEnd.x) {
+            return sideRight;
+        }
+        if (p.y < coreBegin.y) {
+            return sideTop;
+        }
+        if (p.y >= coreEnd.y) {
+            return sideBottom;
+        }
+        return sideNone;
+    }
+};
+
+struct world {
+    std::string root;
+    int width = 0;
+    int height = 0;
+    int tileSize = 256;
+    int margin = 64;
+    double minPathWith = 8;
+    size_t maxTiles = 16;     //同时加载的块数，至少为2
+
+    std::map<tileKey, std::unique_ptr<tile>> tiles{};
+    std::list<tileKey> lru{};  //最近用过的在前
+    std::map<tileKey, std::list<tileKey>::iterator> lruPos{};
+
+    inline int tilesX() const {
+        return (width + tileSize - 1) / tileSize;
+    }
+    inline int tilesY() const {
+        return (height + tileSize - 1) / tileSize;
+    }
+    inline bool contains(const tileKey& k) const {
+        return k.x >= 0 && k.y >= 0 && k.x < tilesX() && k.y < tilesY();
+    }
+    inline tileKey keyOf(const ivec2& p) const {
+        return tileKey{p.x / tileSize, p.y / tileSize};
+    }
+    inline std::string tilePath(const tileKey& k) const {
+        return root + "/tile_" + std::to_string(k.x) + "_" + std::to_string(k.y);
+    }
+    //块的核心区和扩展后的范围
+    inline void tileRect(const tileKey& k, ivec2& coreBegin, ivec2& coreEnd,
+                         ivec2& begin, ivec2& end) const {
+        coreBegin.init(k.x * tileSize, k.y * tileSize);
+        coreEnd.init(std::min(coreBegin.x + tileSize, width), std::min(coreBegin.y + tileSize, height));
+        begin.init(std::max(coreBegin.x - margin, 0), std::max(coreBegin.y - margin, 0));
+        end.init(std::min(coreEnd.x + margin, width), std::min(coreEnd.y + margin, height));
+    }
+};
+
+//把块内navmesh的路线按核心区切开，生成顶点和边
+inline void buildGraph(tile& t) {
+    t.vertices.clear();
+    t.edges.clear();
+    auto& mesh = *t.mesh;
+    std::map<int32_t, int32_t> nodeVertex;
+    auto getNode = [&](int32_t id) {
+        auto it = nodeVertex.find(id);
+        if (it != nodeVertex.end()) {
+            return it->second;
+        }
+        vertex v;
+        v.position = mesh.nodes.at(id - 1)->position + t.origin;
+        v.nodeId = id;
+        int32_t index = t.vertices.size();
+        t.vertices.push_back(std::move(v));
+        nodeVertex[id] = index;
+        return index;
+    };
+    auto addPortal = [&](const ivec2& pos, int side) {
+        vertex v;
+        v.position = pos;
+        v.side = side;
+        int32_t index = t.vertices.size();
+        t.vertices.push_back(std::move(v));
+        return index;
+    };
+    for (auto& it : mesh.ways) {
+        auto& w = *it.second;
+        auto& path = w.maxPath;
+        const int len = path.size();
+        int i = 0;
+        while (i < len) {
+            if (!t.inCore(path[i] + t.origin)) {
+                ++i;
+                continue;
+            }
+            //[s, e]为连续在核心区内的一段
+            int s = i;
+            while (i + 1 < len && t.inCore(path[i + 1] + t.origin)) {
+                ++i;
+            }
+            int e = i;
+            ++i;
+
+            edge ed;
+            ed.way = it.first;
+            ed.begin = s;
+            ed.end = e;
+            ed.minWidth = w.minWidth;
+            for (int k = s; k <= e; ++k) {
+                ed.minWidth = std::min(ed.minWidth, mesh.getSdf(path[k].x, path[k].y));
+                if (k > s) {
+                    ed.length += path[k].length(path[k - 1]);
+                }
+            }
+            if (s == 0 && t.inCore(w.p1->position + t.origin)) {
+                ed.v1 = getNode(w.p1->id);
+            } else {
+                ivec2 outside = s > 0 ? path[s - 1] : w.p1->position;
+                ed.v1 = addPortal(path[s] + t.origin, t.sideOf(outside + t.origin));
+            }
+            if (e == len - 1 && t.inCore(w.p2->position + t.origin)) {
+                ed.v2 = getNode(w.p2->id);
+            } else {
+                ivec2 outside = e < len - 1 ? path[e + 1] : w.p2->position;
+                ed.v2 = addPortal(path[e] + t.origin, t.sideOf(outside + t.origin));
+            }
+            int32_t index = t.edges.size();
+            t.vertices[ed.v1].edges.push_back(index);
+            t.vertices[ed.v2].edges.push_back(index);
+            t.edges.push_back(ed);
+        }
+    }
+}
+
+//打开烘焙好的世界，只读取配置，块在用到时加载
+inline bool open(world& wd, const std::string& root) {
+    auto fp = fopen((root + "/world.txt").c_str(), "r");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fscanf(fp, "%d %d %d %d %lf",
+                     &wd.width, &wd.height, &wd.tileSize, &wd.margin, &wd.minPathWith) == 5;
+    fclose(fp);
+    if (ok) {
+        wd.root = root;
+        wd.tiles.clear();
+        wd.lru.clear();
+        wd.lruPos.clear();
+    }
+    return ok;
+}
+
+inline void touch(world& wd, const tileKey& k) {
+    auto it = wd.lruPos.find(k);
+    if (it != wd.lruPos.end()) {
+        wd.lru.erase(it->second);
+    }
+    wd.lru.push_front(k);
+    wd.lruPos[k] = wd.lru.begin();
+}
+
+//卸载一块
+inline void evict(world& wd, const tileKey& k) {
+    auto it = wd.lruPos.find(k);
+    if (it != wd.lruPos.end()) {
+        wd.lru.erase(it->second);
+        wd.lruPos.erase(it);
+    }
+    wd.tiles.erase(k);
+}
+
+//取一块，没有加载时从磁盘加载，可能淘汰其他块（之前取到的指针随之失效）
+//块不存在（超出范围或没有烘焙）时返回nullptr，没有烘焙的块也会占一个位置，避免反复读盘
+inline tile* get(world& wd, const tileKey& k) {
+    if (!wd.contains(k)) {
+        return nullptr;
+    }
+    auto it = wd.tiles.find(k);
+    if (it != wd.tiles.end()) {
+        touch(wd, k);
+        return it->second.get();
+    }
+    std::unique_ptr<tile> t(new tile);
+    t->key = k;
+    ivec2 end;
+    wd.tileRect(k, t->coreBegin, t->coreEnd, t->origin, end);
+    t->mesh.reset(loader::load(wd.tilePath(k)));
+    if (t->mesh) {
+        buildGraph(*t);
+    }
+    auto res = t.get();
+    wd.tiles[k] = std::move(t);
+    touch(wd, k);
+    while (wd.tiles.size() > std::max<size_t>(wd.maxTiles, 2)) {
+        tileKey last = wd.lru.back();  //evict会删除链表中的这一项，先复制
+        evict(wd, last);
+    }
+    return res->mesh ? res : nullptr;
+}
+
+//顶点的全局引用，块可能被淘汰，所以不保存指针
+struct vertexRef {
+    tileKey tile;
+    int32_t index = -1;
+    inline bool operator<(const vertexRef& o) const {
+        return tile < o.tile || (tile == o.tile && index < o.index);
+    }
+    inline bool operator==(const vertexRef& o) const {
+        return tile == o.tile && index == o.index;
+    }
+};
+
+//两点之间的线段是否都在路宽以内（mesh的坐标）
+inline bool segmentClear(navmesh::navmesh& mesh, const ivec2& a, const ivec2& b, double width) {
+    int steps = std::max(abs(b.x - a.x), abs(b.y - a.y));
+    for (int i = 0; i <= steps; ++i) {
+        double t = steps ? (double)i / steps : 0.;
+        int x = (int)round(a.x + (b.x - a.x) * t);
+        int y = (int)round(a.y + (b.y - a.y) * t);
+        if (x < 0 || y < 0 || x >= mesh.width || y >= mesh.height || mesh.getSdf(x, y) < width) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//匹配块t在side一侧的传送点与相邻块的传送点，结果写入两边顶点的partner
+//两块各自烘焙，山脊在扩展区里的走向不同，切点沿边界可能错开，
+//所以沿边界方向相差不超过margin、之间的线段在路宽以内的都是候选，按距离从近到远一对一配对
+//只依赖两块的内容，从哪一边开始算结果都相同（A配B则B配A）
+inline void matchSide(world& wd, const tileKey& k, int side) {
+    static constexpr int offset[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    tileKey nk{k.x + offset[side][0], k.y + offset[side][1]};
+    auto other = get(wd, nk);
+    auto t = get(wd, k);  //加载other可能淘汰其他块，重新取
+    if (!t) {
+        return;
+    }
+    t->sideMatched[side] = true;
+    if (!other) {
+        return;
+    }
+    other->sideMatched[oppositeSide(side)] = true;
+    //统一按左上的块排列，两边算出的结果相同
+    tile* a = t;
+    tile* b = other;
+    int sa = side;
+    if (side == sideLeft || side == sideTop) {
+        std::swap(a, b);
+        sa = oppositeSide(side);
+    }
+    const bool vertical = sa == sideRight;  //边界是竖线
+    const double width = std::min(wd.minPathWith, (double)wd.margin);
+    std::vector<std::tuple<double, int32_t, int32_t>> pairs;
+    int32_t na = a->vertices.size();
+    int32_t nb = b->vertices.size();
+    for (auto& it : a->vertices) {
+        if (it.side == sa) {
+            it.partner = -1;
+        }
+    }
+    for (auto& it : b->vertices) {
+        if (it.side == oppositeSide(sa)) {
+            it.partner = -1;
+        }
+    }
+    for (int32_t i = 0; i < na; ++i) {
+        auto& va = a->vertices[i];
+        if (va.side != sa) {
+            continue;
+        }
+        for (int32_t j = 0; j < nb; ++j) {
+            auto& vb = b->vertices[j];
+            if (vb.side != oppositeSide(sa)) {
+                continue;
+            }
+            int along = vertical ? abs(va.position.y - vb.position.y) : abs(va.position.x - vb.position.x);
+            if (along > wd.margin ||
+                !segmentClear(*a->mesh, va.position - a->origin, vb.position - a->origin, width)) {
+                continue;
+            }
+            pairs.emplace_back(va.position.length(vb.position), i, j);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    for (auto& [d, i, j] : pairs) {
+        if (a->vertices[i].partner < 0 && b->vertices[j].partner < 0) {
+            a->vertices[i].partner = j;
+            b->vertices[j].partner = i;
+        }
+    }
+}
+
+//与传送点相连的相邻块的传送点，没有时index为-1
+inline vertexRef matchPortal(world& wd, const vertexRef& v) {
+    vertexRef res;
+    auto t = get(wd, v.tile);
+    if (!t) {
+        return res;
+    }
+    int side = t->vertices.at(v.index).side;
+    if (side == sideNone) {
+        return res;
+    }
+    if (!t->sideMatched[side]) {
+        matchSide(wd, v.tile, side);
+        t = get(wd, v.tile);
+    }
+    static constexpr int offset[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int32_t partner = t->vertices.at(v.index).partner;
+    if (partner >= 0) {
+        res.tile = tileKey{v.tile.x + offset[side][0], v.tile.y + offset[side][1]};
+        res.index = partner;
+    }
+    return res;
+}
+
+//与navmesh::removeWaste相同，整个世界只保留经传送点拼起来后最大（路线最长）的一块路网
+//块是保留所有山脊烘焙的（经相邻块可能连通），拼接后仍然不连通的节点、路线和山脊在这里删除，
+//再重建块的上路流场，流场不会把单位引到走不出去的小块路网上
+inline void removeWaste(world& wd) {
+    //第一遍：所有顶点（块、下标）做并查集，块内的边和配对的传送点相连
+    std::map<vertexRef, int32_t> index;
+    std::vector<int32_t> parent;
+    std::vector<double> length;
+    auto find = [&](int32_t a) {
+        while (parent[a] != a) {
+            parent[a] = parent[parent[a]];
+            a = parent[a];
+        }
+        return a;
+    };
+    auto idOf = [&](const vertexRef& v) {
+        auto it = index.find(v);
+        if (it != index.end()) {
+            return it->second;
+        }
+        int32_t id = parent.size();
+        index[v] = id;
+        parent.push_back(id);
+        length.push_back(0);
+        return id;
+    };
+    auto unite = [&](int32_t a, int32_t b, double len) {
+        a = find(a);
+        b = find(b);
+        if (a != b) {
+            parent[b] = a;
+            length[a] += length[b];
+        }
+        length[a] += len;
+    };
+    for (int ty = 0; ty < wd.tilesY(); ++ty) {
+        for (int tx = 0; tx < wd.tilesX(); ++tx) {
+            tileKey k{tx, ty};
+            auto t = get(wd, k);
+            if (!t) {
+                continue;
+            }
+            int32_t count = t->vertices.size();
+            for (int32_t i = 0; i < count; ++i) {
+                idOf(vertexRef{k, i});
+            }
+            for (auto& e : t->edges) {
+                unite(idOf(vertexRef{k, e.v1}), idOf(vertexRef{k, e.v2}), e.length);
+            }
+            //配对会加载相邻块，t可能失效
+            for (int32_t i = 0; i < count; ++i) {
+                vertexRef v{k, i};
+                auto m = matchPortal(wd, v);
+                if (m.index >= 0) {
+                    unite(idOf(v), idOf(m), 0);
+                }
+            }
+        }
+    }
+    int32_t main = -1;
+    for (int32_t i = 0; i < (int32_t)parent.size(); ++i) {
+        if (find(i) == i && (main < 0 || length[i] > length[main])) {
+            main = i;
+        }
+    }
+    if (main < 0) {
+        return;
+    }
+    //第二遍：块内与最大一块相连的节点保留（包括核心区外、经块内路线连上的）
+    for (int ty = 0; ty < wd.tilesY(); ++ty) {
+        for (int tx = 0; tx < wd.tilesX(); ++tx) {
+            tileKey k{tx, ty};
+            auto t = get(wd, k);
+            if (!t) {
+                continue;
+            }
+            auto& mesh = *t->mesh;
+            const int n = mesh.nodes.size();
+            std::vector<int32_t> local(n);
+            for (int i = 0; i < n; ++i) {
+                local[i] = i;
+            }
+            auto findLocal = [&](int32_t a) {
+                while (local[a] != a) {
+                    local[a] = local[local[a]];
+                    a = local[a];
+                }
+                return a;
+            };
+            for (auto& it : mesh.ways) {
+                local[findLocal(it.first.second - 1)] = findLocal(it.first.first - 1);
+            }
+            std::vector<uint8_t> keepLocal(n, 0);
+            int32_t count = t->edges.size();
+            for (int32_t i = 0; i < count; ++i) {
+                auto& e = t->edges[i];
+                if (find(index.at(vertexRef{k, e.v1})) == main) {
+                    keepLocal[findLocal(e.way.first - 1)] = 1;
+                }
+            }
+            std::vector<uint8_t> keep(n, 0);
+            bool changed = false;
+            for (int i = 0; i < n; ++i) {
+                keep[i] = keepLocal[findLocal(i)];
+                changed |= !keep[i];
+            }
+            if (changed) {
+                navmesh::removeNodes(mesh, keep);
+                navmesh::buildAdjacency(mesh);
+                navmesh::buildNavFlowField(mesh, wd.minPathWith);
+                loader::save(mesh, wd.tilePath(k));
+            }
+            evict(wd, k);  //顶点和边已经过时
+        }
+    }
+}
+
+//烘焙整个世界，每块写入root/tile_x_y，没有障碍点的块不生成
+inline bool bake(const std::string& root,
+                 const KDTree& tree,
+                 int width,
+                 int height,
+                 int tileSize = 256,
+                 int margin = 64,
+                 double minPathWith = 8) {
+    if (mkdir(root.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+    world wd;
+    wd.root = root;
+    wd.width = width;
+    wd.height = height;
+    wd.tileSize = tileSize;
+    wd.margin = margin;
+    wd.minPathWith = minPathWith;
+    auto fp = fopen((root + "/world.txt").c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+    fprintf(fp, "%d %d %d %d %.17g\n", width, height, tileSize, margin, minPathWith);
+    fclose(fp);
+
+    bake::options opt;
+    opt.minPathWith = minPathWith;
+    opt.keepIslands = true;  //块内不连通的部分可能经相邻块连通
+    opt.borderNodes = true;  //伸出块的路线在块的边缘有端点
+    for (int ty = 0; ty < wd.tilesY(); ++ty) {
+        for (int tx = 0; tx < wd.tilesX(); ++tx) {
+            tileKey k{tx, ty};
+            ivec2 coreBegin, coreEnd, begin, end;
+            wd.tileRect(k, coreBegin, coreEnd, begin, end);
+            //取扩展范围再向外margin内的点，转为块内坐标
+            //块外的点也参与sdf，块边缘附近的距离与整图相同，山脊不会因为块的边缘而弯折
+            ivec2 pointsBegin(begin.x - margin, begin.y - margin);
+            ivec2 pointsEnd(end.x + margin, end.y + margin);
+            vec2 center((pointsBegin.x + pointsEnd.x) * 0.5, (pointsBegin.y + pointsEnd.y) * 0.5);
+            double rad = vec2(pointsEnd.x - pointsBegin.x, pointsEnd.y - pointsBegin.y).norm() * 0.5 + 1;
+            std::vector<vec2> points;
+            bool inside = false;
+            tree.radius(center, rad, [&](const KDPoint& p) {
+                if (p.pos.x >= pointsBegin.x && p.pos.y >= pointsBegin.y &&
+                    p.pos.x < pointsEnd.x && p.pos.y < pointsEnd.y) {
+                    points.push_back(vec2(p.pos.x - begin.x, p.pos.y - begin.y));
+                    inside |= p.pos.x >= begin.x && p.pos.y >= begin.y && p.pos.x < end.x && p.pos.y < end.y;
+                }
+            });
+            if (!inside) {
+                continue;
+            }
+            KDTree localTree(points);
+            navmesh::navmesh mesh(end.x - begin.x, end.y - begin.y);
+            //只有世界的边缘是障碍物
+            mesh.boundBegin.init(-begin.x, -begin.y);
+            mesh.boundEnd.init(width - begin.x, height - begin.y);
+            bake::run(mesh, localTree, opt);
+            auto path = wd.tilePath(k);
+            if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+            loader::save(mesh, path);
+        }
+    }
+    removeWaste(wd);
+    return true;
+}
+
+//把路线maxPath中[from, to]（to可以小于from）的点转为世界坐标追加到path
+inline void appendWay(tile& t, const std::pair<int32_t, int32_t>& way,
+                      int32_t from, int32_t to, std::vector<ivec2>& path) {
+    auto it = t.mesh->ways.find(way);
+    if (it == t.mesh->ways.end()) {
+        return;
+    }
+    auto& maxPath = it->second->maxPath;
+    int32_t dir = to >= from ? 1 : -1;
+    for (int32_t i = from;; i += dir) {
+        path.push_back(maxPath.at(i) + t.origin);
+        if (i == to) {
+            break;
+        }
+    }
+}
+inline double wayLength(tile& t, const std::pair<int32_t, int32_t>& way, int32_t from, int32_t to) {
+    auto it = t.mesh->ways.find(way);
+    if (it == t.mesh->ways.end()) {
+        return 0;
+    }
+    auto& maxPath = it->second->maxPath;
+    if (from > to) {
+        std::swap(from, to);
+    }
+    double res = 0;
+    for (int32_t i = from + 1; i <= to; ++i) {
+        res += maxPath[i].length(maxPath[i - 1]);
+    }
+    return res;
+}
+
+//路上一点在块内的位置：所在的边及在路线中的下标，或者就在节点上
+struct roadPoint {
+    tileKey tile;
+    std::vector<ivec2> toRoad{};  //从起点到路上的格子（世界坐标）
+    int32_t edge = -1;
+    int32_t index = 0;
+    int32_t vertex = -1;
+};
+
+//从pos沿流场走到路上
+//块是单独烘焙的，流场可能把pos引到扩展区里的路上，这时换到拥有那个格子的块，从那里继续走
+inline bool findRoad(world& wd, const ivec2& pos, roadPoint& res) {
+    const int maxHops = 4;  //来回换块时放弃
+    res.toRoad.clear();
+    res.edge = -1;
+    res.index = 0;
+    res.vertex = -1;
+    ivec2 p = pos;
+    for (int hop = 0; hop < maxHops; ++hop) {
+        res.tile = wd.keyOf(p);
+        auto t = get(wd, res.tile);
+        if (!t) {
+            return false;
+        }
+        std::vector<ivec2> pathPos;
+        ivec2 road;
+        if (!navmesh::toRoad(*t->mesh, p - t->origin, pathPos, road)) {
+            return false;
+        }
+        //换块后的第一个格子就是上一段的最后一个格子
+        for (size_t i = res.toRoad.empty() ? 0 : 1; i < pathPos.size(); ++i) {
+            res.toRoad.push_back(pathPos[i] + t->origin);
+        }
+        if (!t->inCore(road + t->origin)) {  //路在扩展区里
+            p = road + t->origin;
+            continue;
+        }
+        auto dis = t->mesh->getPathDis(road.x, road.y);
+        if (dis.secondNode <= 0) {  //在节点上
+            int32_t count = t->vertices.size();
+            for (int32_t i = 0; i < count; ++i) {
+                if (t->vertices[i].nodeId == dis.firstNode) {
+                    res.vertex = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+        std::pair<int32_t, int32_t> way(std::min(dis.firstNode, dis.secondNode),
+                                        std::max(dis.firstNode, dis.secondNode));
+        int32_t count = t->edges.size();
+        for (int32_t i = 0; i < count; ++i) {
+            auto& e = t->edges[i];
+            if (e.way == way && e.begin <= dis.pointIndex && dis.pointIndex <= e.end) {
+                res.edge = i;
+                res.index = dis.pointIndex;
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+//在世界中寻路，按需加载沿途的块，path为世界坐标的格子
+//路宽不超过minPathWidth的边不能通过
+inline bool findPath(world& wd,
+                     const ivec2& begin,
+                     const ivec2& target,
+                     std::vector<ivec2>& path,
+                     double minPathWidth = 8) {
+    path.clear();
+    roadPoint rb, rt;
+    if (!findRoad(wd, begin, rb) || !findRoad(wd, target, rt)) {
+        return false;
+    }
+    //起点、终点为虚拟顶点
+    const vertexRef startRef{rb.tile, -1};
+    const vertexRef endRef{rt.tile, -2};
+    struct state {
+        double g = INFINITY;
+        vertexRef parent;
+        int32_t edge = -1;  //到达时经过的块内边，-1为块之间相连或虚拟边
+        bool closed = false;
+    };
+    std::map<vertexRef, state> states;
+    using item_t = std::pair<double, vertexRef>;
+    auto itemGreater = [](const item_t& a, const item_t& b) {
+        return a.first > b.first;
+    };
+    std::priority_queue<item_t, std::vector<item_t>, decltype(itemGreater)> open(itemGreater);
+    auto h = [&](const ivec2& p) {
+        return p.length(target);
+    };
+    auto relax = [&](const vertexRef& from, double g, const vertexRef& to,
+                     const ivec2& toPos, double length, int32_t edge) {
+        auto& s = states[to];
+        if (s.closed || s.g <= g + length) {
+            return;
+        }
+        s.g = g + length;
+        s.parent = from;
+        s.edge = edge;
+        open.push(item_t(s.g + h(toPos), to));
+    };
+    //虚拟顶点连到所在边的两端或所在节点
+    struct link {
+        vertexRef vertex;
+        ivec2 position;
+        double length = 0;
+        int32_t edge = -1;
+    };
+    auto roadLinks = [&](const roadPoint& r, std::vector<link>& res) {
+        auto t = get(wd, r.tile);
+        if (!t) {
+            return;
+        }
+        if (r.vertex >= 0) {
+            res.push_back(link{vertexRef{r.tile, r.vertex}, t->vertices[r.vertex].position, 0., -1});
+            return;
+        }
+        auto& e = t->edges[r.edge];
+        if (e.minWidth <= minPathWidth) {
+            return;
+        }
+        res.push_back(link{vertexRef{r.tile, e.v1}, t->vertices[e.v1].position,
+                           wayLength(*t, e.way, r.index, e.begin), r.edge});
+        res.push_back(link{vertexRef{r.tile, e.v2}, t->vertices[e.v2].position,
+                           wayLength(*t, e.way, r.index, e.end), r.edge});
+    };
+    std::vector<link> startLinks, endLinks;
+    roadLinks(rb, startLinks);
+    roadLinks(rt, endLinks);
+
+    states[startRef].g = 0;
+    open.push(item_t(h(begin), startRef));
+    bool found = false;
+    while (!open.empty()) {
+        auto [f, current] = open.top();
+        open.pop();
+        auto& cs = states[current];
+        if (cs.closed) {
+            continue;
+        }
+        cs.closed = true;
+        double g = cs.g;
+        if (current == endRef) {
+            found = true;
+            break;
+        }
+        if (current == startRef) {
+            for (auto& l : startLinks) {
+                relax(startRef, 0, l.vertex, l.position, l.length, l.edge);
+            }
+            //起点终点在同一条边上
+            if (rb.edge >= 0 && rb.tile == rt.tile && rb.edge == rt.edge) {
+                auto t = get(wd, rb.tile);
+                relax(startRef, 0, endRef, target,
+                      wayLength(*t, t->edges[rb.edge].way, rb.index, rt.index), rb.edge);
+            }
+            continue;
+        }
+        //块内的边
+        auto t = get(wd, current.tile);
+        if (!t) {
+            continue;
+        }
+        auto v = t->vertices.at(current.index);
+        for (auto ei : v.edges) {
+            auto& e = t->edges[ei];
+            if (e.minWidth <= minPathWidth) {
+                continue;
+            }
+            int32_t other = e.v1 == current.index ? e.v2 : e.v1;
+            relax(current, g, vertexRef{current.tile, other}, t->vertices[other].position, e.length, ei);
+        }
+        //到终点
+        for (auto& l : endLinks) {
+            if (l.vertex == current) {
+                relax(current, g, endRef, target, l.length, l.edge);
+            }
+        }
+        //相邻块（可能加载新块，t随之失效）
+        if (v.side != sideNone) {
+            auto m = matchPortal(wd, current);
+            if (m.index >= 0) {
+                auto mt = get(wd, m.tile);
+                auto pos = mt->vertices[m.index].position;
+                relax(current, g, m, pos, pos.length(v.position), -1);
+            }
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    //从终点回溯，再翻转
+    std::vector<vertexRef> road;
+    for (vertexRef p = endRef;; p = states[p].parent) {
+        road.push_back(p);
+        if (p == startRef) {
+            break;
+        }
+    }
+    std::reverse(road.begin(), road.end());
+    path = rb.toRoad;
+    for (size_t i = 1; i < road.size(); ++i) {
+        auto& from = road[i - 1];
+        auto& to = road[i];
+        int32_t ei = states[to].edge;
+        if (ei < 0) {  //块之间相连，或者起点就在节点上
+            if (from != startRef && to != endRef && from.tile != to.tile) {
+                //配对的端口最多相距margin，补上中间的格子（这段已经检查过可以通过）
+                auto a = get(wd, from.tile)->vertices[from.index].position;
+                auto b = get(wd, to.tile)->vertices[to.index].position;
+                int n = std::max(abs(b.x - a.x), abs(b.y - a.y));
+                for (int k = 1; k <= n; ++k) {
+                    path.push_back(ivec2(a.x + (b.x - a.x) * k / n, a.y + (b.y - a.y) * k / n));
+                }
+            }
+            continue;
+        }
+        auto edgeTile = to == endRef ? rt.tile : (from == startRef ? rb.tile : to.tile);
+        auto t = get(wd, edgeTile);
+        auto& e = t->edges[ei];
+        auto indexOf = [&](const vertexRef& r) {
+            if (r == startRef) {
+                return rb.index;
+            }
+            if (r == endRef) {
+                return rt.index;
+            }
+            return r.index == e.v1 ? e.begin : e.end;
+        };
+        appendWay(*t, e.way, indexOf(from), indexOf(to), path);
+    }
+    for (auto it = rt.toRoad.rbegin(); it != rt.toRoad.rend(); ++it) {
+        path.push_back(*it);
+    }
+    return true;
+}
+
+}  // namespace sdpf::world